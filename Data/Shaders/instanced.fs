@@ -0,0 +1,18 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// Input uniform values
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+// Output fragment color
+out vec4 finalColor;
+
+void main()
+{
+    // Material color and texture, vertex color times the instance tint
+    finalColor = texture(texture0, fragTexCoord)*colDiffuse*fragColor;
+}
@@ -0,0 +1,32 @@
+#version 330
+
+// Input vertex attributes
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in vec4 vertexColor;
+in mat4 instanceTransform;
+
+// Input uniform values
+uniform mat4 mvp;
+
+// Output vertex attributes (to fragment shader)
+out vec2 fragTexCoord;
+out vec4 fragColor;
+
+void main()
+{
+    // The bottom row of an affine transform is (0, 0, 0, 1); the renderer
+    // stores the instance tint there instead
+    vec4 tint = vec4(instanceTransform[0][3], instanceTransform[1][3], instanceTransform[2][3], instanceTransform[3][3]);
+    fragColor = vertexColor*tint;
+    mat4 model = instanceTransform;
+    model[0][3] = 0.0;
+    model[1][3] = 0.0;
+    model[2][3] = 0.0;
+    model[3][3] = 1.0;
+
+    fragTexCoord = vertexTexCoord;
+
+    // Calculate final vertex position
+    gl_Position = mvp*model*vec4(vertexPosition, 1.0);
+}
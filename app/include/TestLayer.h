@@ -84,10 +84,15 @@ public:
       MainScene->OnUpdate(dt);
       break;
     case RE::SceneState::Play:
-      MainScene->OnUpdateRuntime(dt);
+      RuntimeScene->OnUpdateRuntime(dt);
       break;
     }
 
+    // editor picking; clicks on ImGui windows are not for the scene
+    if(m_SceneState == RE::SceneState::Edit && IsMouseButtonPressed(MOUSE_BUTTON_LEFT) &&
+       !ImGui::GetIO().WantCaptureMouse)
+      m_Selected = MainScene->Pick(GetMousePosition());
+
     if(IsKeyPressed(KEY_TAB)){
       if(m_SceneState == RE::SceneState::Edit)
 	OnScenePlay();
@@ -110,13 +115,23 @@ public:
     DrawVec3Control("Man Scale", manTC.Scale);
     ImGui::Separator();
     DrawVec3Control("cube pos", cubeTC.Translation);
+    ImGui::Separator();
+    if(m_Selected){
+      const auto name = m_Selected.GetName();
+      ImGui::Text("Selected: %.*s", (int)name.size(), name.data());
+      DrawVec3Control("Selected Pos", m_Selected.GetComponent<RE::TransformComponent>().Translation);
+    }
     ImGui::End();
+
+    DrawPhysicsStats((RuntimeScene ? RuntimeScene : MainScene)->GetPhysics3D().GetStats());
   }
 
 private:
   void OnScenePlay(){
     m_SceneState = RE::SceneState::Play;
-    MainScene->OnRuntimeStart();
+    // play on a copy; the edit scene is never touched by the simulation
+    RuntimeScene = RE::Scene::Copy(MainScene);
+    RuntimeScene->OnRuntimeStart();
   }
 
   void OnSceneStop(){
@@ -125,13 +140,16 @@ private:
     }
 
     m_SceneState = RE::SceneState::Edit;
-    MainScene->OnRuntimeStop();
+    RuntimeScene->OnRuntimeStop();
+    RuntimeScene = nullptr;
   }
 
 private:
   RE::Ref<RE::Scene> MainScene;
+  RE::Ref<RE::Scene> RuntimeScene;
   RE::SceneState m_SceneState = RE::SceneState::Edit;
 
   RE::Entity manEntt;
   RE::Entity cube; 
+  RE::Entity m_Selected;
 };
@@ -0,0 +1,178 @@
+// View against group iteration over the component pairs Scene keeps in
+// groups. Every entity has a transform and one of a rigidbody, a cube or a
+// model, so each view has to skip the entities its group never visits.
+// On Linux the cache misses of each pass are counted with perf_event_open
+// where the kernel allows it (perf_event_paranoid); elsewhere only time.
+//
+//   cmake -S . -B build -DRE_BENCHMARKS=ON -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build --target ViewVsGroup && build/bin/ViewVsGroup
+
+#include "repch.h"
+#include "Scene/Components.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace RE;
+
+namespace {
+  constexpr int ENTITY_COUNT = 100000;
+  constexpr int REPEATS = 50;
+
+  // hardware cache-miss counter of this thread; Available() is false where
+  // the platform or the kernel's settings do not allow it
+  class CacheMissCounter {
+  public:
+#if defined(__linux__)
+    CacheMissCounter() {
+      perf_event_attr attr{};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      m_Fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~CacheMissCounter() { if (m_Fd >= 0) close(m_Fd); }
+
+    bool Available() const { return m_Fd >= 0; }
+
+    void Start() {
+      if (m_Fd < 0) return;
+      ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t Stop() {
+      if (m_Fd < 0) return 0;
+      ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t count = 0;
+      return read(m_Fd, &count, sizeof(count)) == sizeof(count) ? count : 0;
+    }
+
+  private:
+    int m_Fd = -1;
+#else
+    bool Available() const { return false; }
+    void Start() {}
+    uint64_t Stop() { return 0; }
+#endif
+  };
+
+  struct Result {
+    double ns = 1e30;     // per visited entity, best run
+    double misses = 0.0;  // per visited entity, in that run
+  };
+
+  void Populate(entt::registry& registry){
+    for (int i = 0; i < ENTITY_COUNT; ++i) {
+      const entt::entity entity = registry.create();
+      registry.emplace<TransformComponent>(entity, Vector3{ (float)i, 0.0f, 0.0f });
+      switch (i % 3) {
+      case 0: {
+	auto& body = registry.emplace<RigidbodyComponent>(entity);
+	body.body = nullptr;
+	body.type = BodyType::Dynamic;
+	break;
+      }
+      case 1:
+	registry.emplace<CubeComponent>(entity);
+	break;
+      default:
+	registry.emplace<ModelComponent>(entity);
+	break;
+      }
+    }
+  }
+
+  template<typename Pass>
+  Result Measure(CacheMissCounter& counter, Pass&& pass){
+    Result best;
+    for (int r = 0; r < REPEATS; ++r) {
+      counter.Start();
+      const auto start = std::chrono::steady_clock::now();
+      const size_t visited = std::max<size_t>(pass(), 1);
+      const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      const uint64_t misses = counter.Stop();
+      if (elapsed.count() / visited < best.ns) {
+	best.ns = elapsed.count() / visited;
+	best.misses = (double)misses / visited;
+      }
+    }
+    return best;
+  }
+
+  // one pass over `range`, reading or writing what the Scene's loop does
+  template<typename Range, typename Fn>
+  size_t Visit(Range&& range, Fn&& fn){
+    size_t visited = 0;
+    for (auto [entity, comp, transform] : range.each()) {
+      fn(comp, transform);
+      ++visited;
+    }
+    return visited;
+  }
+
+  void Report(const char* name, const char* group, const Result& view, const Result& grouped, bool misses){
+    std::printf("  %-20s view %6.2f ns  %-20s %6.2f ns  (%.2fx)", name, view.ns, group, grouped.ns, view.ns / grouped.ns);
+    if (misses)
+      std::printf("   misses %.3f -> %.3f", view.misses, grouped.misses);
+    std::printf("\n");
+  }
+
+  volatile float g_Sink;
+}
+
+int main(){
+  entt::registry viewRegistry;
+  Populate(viewRegistry);
+
+  entt::registry groupRegistry;
+  // declared before any component exists, as Scene does
+  auto physics = groupRegistry.group<RigidbodyComponent, TransformComponent>();
+  auto cubes = groupRegistry.group<CubeComponent>(entt::get<TransformComponent>);
+  auto models = groupRegistry.group<ModelComponent>(entt::get<TransformComponent>);
+  Populate(groupRegistry);
+
+  CacheMissCounter counter;
+  float sum = 0.0f;
+  const auto step = [](RigidbodyComponent& body, TransformComponent& transform) {
+    transform.Translation.y += body.type == BodyType::Dynamic ? 0.01f : 0.0f;
+  };
+  const auto readCube = [&sum](const CubeComponent& cube, const TransformComponent& transform) {
+    sum += transform.Translation.x * cube.color.r;
+  };
+  const auto readModel = [&sum](const ModelComponent& model, const TransformComponent& transform) {
+    sum += transform.Scale.x * model.color.a;
+  };
+
+  const Result physicsView = Measure(counter, [&] {
+    return Visit(viewRegistry.view<RigidbodyComponent, TransformComponent>(), step);
+  });
+  const Result physicsGroup = Measure(counter, [&] { return Visit(physics, step); });
+  const Result cubeView = Measure(counter, [&] {
+    return Visit(viewRegistry.view<CubeComponent, TransformComponent>(), readCube);
+  });
+  const Result cubeGroup = Measure(counter, [&] { return Visit(cubes, readCube); });
+  const Result modelView = Measure(counter, [&] {
+    return Visit(viewRegistry.view<ModelComponent, TransformComponent>(), readModel);
+  });
+  const Result modelGroup = Measure(counter, [&] { return Visit(models, readModel); });
+  g_Sink = sum;
+
+  const bool misses = counter.Available();
+  std::printf("%d entities, best of %d runs, per entity%s\n", ENTITY_COUNT, REPEATS,
+	      misses ? "" : " (cache misses unavailable here)");
+  Report("Rigidbody+Transform", "full-owning group", physicsView, physicsGroup, misses);
+  Report("Cube+Transform", "partial-owning group", cubeView, cubeGroup, misses);
+  Report("Model+Transform", "partial-owning group", modelView, modelGroup, misses);
+  return 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Core/Config.h"
+#include "Auxiliaries/MeshBVH.h"
 #include <filesystem>
 
 namespace RE {
@@ -42,6 +43,8 @@ namespace RE {
 
   struct ModelAsset : Asset {
     Model Data{};
+    BoundingBox Bounds{};   // model space, computed once on load
+    Ref<ModelBVH> BVH;      // per-mesh triangle BVHs for picking
   };
 
   struct SkyboxAsset : Asset {
@@ -52,8 +55,8 @@ namespace RE {
     // Sprite Data{};
   };
 
+  // binary scene file (.rscn); Source is loaded with SceneSerializer::DeserializeBinary
   struct SceneAsset : Asset {
-    // to do
   };
 
   struct ScriptAsset : Asset {
@@ -107,6 +110,8 @@ namespace RE {
     {
       auto asset = CreateRef<ModelAsset>();
       asset->Data = LoadModel(source.c_str());
+      asset->Bounds = GetModelBoundingBox(asset->Data);
+      asset->BVH = CreateRef<ModelBVH>(asset->Data);
       asset->Type = AssetType::MODEL;
       Add(uid, source, asset);
       return asset;
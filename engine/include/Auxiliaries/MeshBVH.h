@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Core/Config.h"
+#include <vector>
+
+namespace RE {
+
+  struct MeshHit {
+    float distance = 0.0f;  // along the ray as given, in its direction's units
+    int mesh = -1;          // ModelBVH only
+    int triangle = -1;
+    float u = 0.0f, v = 0.0f; // barycentrics of the hit in the triangle
+  };
+
+  // Binned-SAH BVH over one mesh's triangles. Leaves keep their triangles four
+  // to a packet (vertex plus two edges, SoA), so a ray is tested against four
+  // at a time with SSE where it is available.
+  class MeshBVH {
+  public:
+    MeshBVH() = default;
+    explicit MeshBVH(const Mesh& mesh) { Build(mesh); }
+
+    void Build(const Mesh& mesh);
+
+    // nearest triangle hit closer than maxDistance; the ray is in mesh space
+    bool RayCast(const Ray& ray, float maxDistance, MeshHit& hit) const;
+
+    uint32_t GetTriangleCount() const { return m_TriangleCount; }
+    size_t GetNodeCount() const { return m_Nodes.size(); }
+
+  private:
+    // inner nodes: count == 0, children at first and first + 1
+    // leaves: `count` packets starting at `first`
+    struct Node {
+      float min[3];
+      uint32_t first;
+      float max[3];
+      uint32_t count;
+    };
+
+    struct alignas(16) Packet {
+      float v0[3][4];
+      float e1[3][4];
+      float e2[3][4];
+      int32_t index[4]; // -1 for padding lanes
+    };
+
+    static bool IntersectPacket(const Packet& packet, const Ray& ray, float best, MeshHit& hit);
+
+    std::vector<Node> m_Nodes;
+    std::vector<Packet> m_Packets;
+    uint32_t m_TriangleCount = 0;
+  };
+
+  // one MeshBVH per mesh of a model; ModelAsset builds it on load
+  struct ModelBVH {
+    std::vector<MeshBVH> meshes;
+
+    ModelBVH() = default;
+    explicit ModelBVH(const Model& model);
+
+    // `transform` takes model space to world space, as the model is drawn
+    bool RayCast(const Ray& ray, const Matrix& transform, float maxDistance, MeshHit& hit) const;
+  };
+}
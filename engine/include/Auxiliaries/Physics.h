@@ -4,6 +4,10 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <array>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 // Forward declare Bullet types to avoid leaking heavy headers in user headers
 struct btBroadphaseInterface;
@@ -14,6 +18,11 @@ struct btDiscreteDynamicsWorld;
 struct btCollisionShape;
 struct btRigidBody;
 struct btTransform;
+struct btOverlapFilterCallback;
+struct btCollisionObject;
+class btPairCachingGhostObject;
+class btGhostPairCallback;
+class CProfileIterator;
 
 namespace RE {
 
@@ -27,6 +36,96 @@ namespace RE {
     void* body = nullptr;
 };
 
+// Collision layers: a body on layer N uses Bullet group bit (1 << N).
+using CollisionLayer = uint8_t;
+constexpr CollisionLayer MAX_COLLISION_LAYERS = 32;
+
+namespace CollisionLayers {
+  constexpr CollisionLayer Default = 0;
+  constexpr CollisionLayer Static  = 1;
+  constexpr CollisionLayer Debris  = 2;
+  constexpr CollisionLayer Trigger = 3;
+}
+
+// Symmetric layer-vs-layer collision table; one 32-bit mask per layer.
+// Defaults: everything collides except Debris-Debris and Trigger-Static.
+struct CollisionMatrix {
+  CollisionMatrix() {
+    masks.fill(0xFFFFFFFFu);
+    Set(CollisionLayers::Debris, CollisionLayers::Debris, false);
+    Set(CollisionLayers::Trigger, CollisionLayers::Static, false);
+  }
+
+  void Set(CollisionLayer a, CollisionLayer b, bool collide) {
+    if (a >= MAX_COLLISION_LAYERS || b >= MAX_COLLISION_LAYERS) return;
+    if (collide) {
+      masks[a] |= (1u << b);
+      masks[b] |= (1u << a);
+    } else {
+      masks[a] &= ~(1u << b);
+      masks[b] &= ~(1u << a);
+    }
+  }
+
+  bool Collides(CollisionLayer a, CollisionLayer b) const {
+    if (a >= MAX_COLLISION_LAYERS || b >= MAX_COLLISION_LAYERS) return true;
+    return (masks[a] & (1u << b)) != 0;
+  }
+
+  uint32_t GetMask(CollisionLayer layer) const {
+    return layer < MAX_COLLISION_LAYERS ? masks[layer] : 0xFFFFFFFFu;
+  }
+
+  std::array<uint32_t, MAX_COLLISION_LAYERS> masks;
+};
+
+// Trigger overlap change reported once per step: `entered` false means exit.
+struct TriggerEvent {
+  void* trigger = nullptr;
+  void* other = nullptr;
+  bool entered = false;
+};
+
+// One node of Bullet's CProfileManager tree for the last step; `depth` 0 is the
+// outermost scope (stepSimulation). Names are Bullet's static scope strings.
+struct PhysicsPhaseTiming {
+  const char* name = "";
+  float ms = 0.0f;
+  int calls = 0;
+  int depth = 0;
+};
+
+// Counters gathered at the end of every Physics3D::Step().
+struct PhysicsStats {
+  int subSteps = 0;
+  int broadphasePairs = 0;   // overlapping pairs in the broadphase cache
+  int manifolds = 0;         // narrowphase manifolds alive
+  int touchingManifolds = 0; // manifolds with at least one contact point
+  int contacts = 0;
+  int islands = 0;
+  int activeBodies = 0;
+  int sleepingBodies = 0;
+  int staticBodies = 0;
+  int triggers = 0;
+  int triggerEvents = 0;
+  float stepMs = 0.0f;       // wall time of stepSimulation
+  std::vector<PhysicsPhaseTiming> phases;
+
+  // time of the first phase called `name`, 0 if Bullet did not report it
+  float GetPhaseMs(std::string_view name) const {
+    for (const auto& phase : phases)
+      if (name == phase.name) return phase.ms;
+    return 0.0f;
+  }
+};
+
+// Child of a compound collider: an existing shape posed relative to the body.
+struct CompoundChild {
+  btCollisionShape* shape = nullptr;
+  Vector3 offset = { 0.0f, 0.0f, 0.0f };
+  Vector3 rotation = { 0.0f, 0.0f, 0.0f };
+};
+
 class Physics {
 public:
     virtual ~Physics() = default;
@@ -80,13 +179,46 @@ public:
     // - shape: pointer to btCollisionShape (ownership can be transferred or kept; we provide helper to own shapes)
     // - mass: mass in kg; use 0.0f for static bodies
     // - startTransform: array of 7 floats: pos xyz, quat x y z w (or pass identity)
+    // - layer: collision layer; group/mask are taken from the collision matrix
     // Returns a void* handle to the created btRigidBody (caller treats as opaque). Use RemoveRigidBody to destroy.
-    void* AddRigidBody(btCollisionShape* shape, float mass, const Vector3& pos, const Vector3& rotation);
+    void* AddRigidBody(btCollisionShape* shape, float mass, const Vector3& pos, const Vector3& rotation,
+                       CollisionLayer layer = CollisionLayers::Default);
+
+    // Bulk AddRigidBody: `count` bodies sharing one shape, written to outBodies.
+    // Inertia is computed once and the body list grows once. The shared shape is
+    // destroyed with the last of its bodies.
+    void AddRigidBodies(btCollisionShape* shape, float mass, const Vector3* positions, const Vector3* rotations,
+                        size_t count, CollisionLayer layer, void** outBodies);
 
     // Remove and destroy a rigid body previously created by AddRigidBody.
     // If `destroyShape` is true the collision shape will also be deleted if it is owned by this wrapper.
     void RemoveRigidBody(void* bodyHandle, bool destroyShape = true);
 
+    // Bulk RemoveRigidBody: the owned list, trigger overlap sets and shape users
+    // are each walked once for the whole batch. Null and repeated handles are skipped.
+    void RemoveRigidBodies(void* const* bodyHandles, size_t count, bool destroyShapes = true);
+
+    // Create a trigger volume (btPairCachingGhostObject, no contact response).
+    // Its overlap list is kept by the broadphase; Step() diffs it against the previous
+    // step and only reports enter/exit changes through GetTriggerEvents().
+    void* AddTrigger(btCollisionShape* shape, const Vector3& pos, const Vector3& rotation,
+                     CollisionLayer layer = CollisionLayers::Trigger);
+    // Bulk AddTrigger: `count` ghosts sharing one shape, written to outTriggers.
+    // The shared shape is destroyed with the last of its triggers.
+    void AddTriggers(btCollisionShape* shape, const Vector3* positions, const Vector3* rotations,
+                     size_t count, CollisionLayer layer, void** outTriggers);
+    void RemoveTrigger(void* triggerHandle, bool destroyShape = true);
+    void RemoveTriggers(void* const* triggerHandles, size_t count, bool destroyShapes = true);
+
+    // move a trigger; its AABB is refreshed on the next Step()
+    void SetTriggerTransform(void* triggerHandle, const Vector3& pos, const Vector3& rotation);
+
+    // enter/exit changes produced by the last Step()
+    const std::vector<TriggerEvent>& GetTriggerEvents() const { return m_triggerEvents; }
+
+    // per-step counters and Bullet profile timings from the last Step()
+    const PhysicsStats& GetStats() const { return m_stats; }
+
     // Convenience helpers: create common shapes (ownership transferred to Physics3D)
     btCollisionShape* CreateBoxShape(float hx, float hy, float hz);   // half extents
     btCollisionShape* CreateSphereShape(float radius);
@@ -97,7 +229,22 @@ public:
   // Example: horizontal ground at y = 0 -> normal=(0,1,0), planeConstant = 0
   // Returns btCollisionShape* owned by Physics3D (will be deleted in Shutdown()).
   btCollisionShape* CreatePlaneShape(float normalX, float normalY, float normalZ, float planeConstant);
+  // Combine child shapes into one btCompoundShape (dynamic AABB tree enabled) so a
+  // multi-part prop is a single body and broadphase proxy. Children must already be
+  // owned by Physics3D; destroying the compound through RemoveRigidBody destroys them too.
+  btCollisionShape* CreateCompoundShape(const std::vector<CompoundChild>& children);
+  // Heightfield over an int16 grid (PHY_SHORT). `heights` is referenced, not copied,
+  // and must outlive the shape. Bullet centres the shape on its AABB, so place the
+  // body at the grid's centre (see Terrain::GetCollisionCenter).
+  btCollisionShape* CreateHeightfieldShape(int width, int length, const int16_t* heights, float heightScale,
+                                           int16_t minHeight, int16_t maxHeight, float cellSize);
+
 
+  // Layer collision matrix. The broadphase filter reads it live, so edits apply to
+  // new pairs immediately; pairs already in the cache persist until they separate.
+  void SetLayerCollision(CollisionLayer a, CollisionLayer b, bool collide);
+  CollisionMatrix& GetCollisionMatrix() { return m_layerMatrix; }
+  const CollisionMatrix& GetCollisionMatrix() const { return m_layerMatrix; }
 
     // Raycast from `from` to `to` in world coords
     RaycastHit Raycast(const float from[3], const float to[3]);
@@ -113,6 +260,14 @@ private:
     // internal helpers
     btTransform ToBtTransform(const Vector3& pos, const float tr[4]) const;
     void FromBtTransform(const btTransform& t, float outTransform[7]) const;
+    void UpdateTriggers();
+    void CollectStats(int subSteps, float stepMs);
+    void CollectPhases(CProfileIterator* it, int depth);
+    void ForgetTriggerOverlaps(const std::unordered_set<btCollisionObject*>& objects);
+    // deletes those of `shapes` created by the Create* helpers
+    void DestroyOwnedShapes(const std::vector<btCollisionShape*>& shapes);
+    // drops one body's use of a shape; true if it was the last
+    bool ReleaseShapeUser(btCollisionShape* shape);
 
 private:
     // Bullet main objects (opaque here; defined in cpp)
@@ -121,10 +276,28 @@ private:
     btCollisionDispatcher* m_dispatcher = nullptr;
     btSequentialImpulseConstraintSolver* m_solver = nullptr;
     btDiscreteDynamicsWorld* m_dynamicsWorld = nullptr;
+    btOverlapFilterCallback* m_filterCallback = nullptr;
+    btGhostPairCallback* m_ghostPairCallback = nullptr;
+
+    // layer table, survives Reset()
+    CollisionMatrix m_layerMatrix;
 
     // owned shapes and bodies to make lifetime management simple
     std::vector<btCollisionShape*> m_ownedShapes;
     std::vector<btRigidBody*> m_ownedBodies;
+    std::unordered_map<btCollisionShape*, uint32_t> m_shapeUsers; // bodies per shape
+
+    // triggers with their overlap set (sorted) from the previous step
+    struct TriggerState {
+      btPairCachingGhostObject* ghost = nullptr;
+      std::vector<btCollisionObject*> overlaps;
+    };
+    std::vector<TriggerState> m_triggers;
+    std::vector<TriggerEvent> m_triggerEvents;
+    std::vector<btCollisionObject*> m_overlapScratch;
+
+    PhysicsStats m_stats;
+    std::vector<int> m_islandScratch;
 
     bool m_initialized = false;
     bool m_running = true;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Core/Config.h"
+#include <vector>
+#include <string>
+
+namespace RE {
+
+  struct TerrainSettings {
+    float cellSize = 1.0f;          // world units between height samples
+    float heightScale = 1.0f / 256.0f; // world units per 16-bit height step
+    int chunkQuads = 64;            // quads per chunk side (max 254, 16-bit indices)
+    int lodCount = 5;               // LOD n samples every (1 << n)th vertex
+    float lodDistance = 64.0f;      // LOD 0 range; each further LOD doubles it
+    float viewDistance = 1000.0f;   // chunks beyond this are skipped and their meshes freed
+    int rebuildBudget = 8;          // chunk meshes rebuilt per frame at most
+  };
+
+  // Heightmap terrain split into chunks. Heights are stored once as int16 (raw 16-bit
+  // value - 32768) so the same buffer feeds both the LOD meshes and Bullet's
+  // btHeightfieldTerrainShape (PHY_SHORT) without a copy. The terrain grid starts at
+  // the owner's position and extends along +X/+Z; rotation and scale are ignored.
+  class Terrain {
+  public:
+    Terrain() = default;
+    ~Terrain();
+
+    // .r16/.raw: square little-endian 16-bit heights; anything else goes through
+    // raylib's LoadImage as 8-bit grayscale widened to 16 bits.
+    bool LoadHeightmap(const std::string& path, const TerrainSettings& settings = {});
+    bool LoadFromData(const uint16_t* heights, int width, int length, const TerrainSettings& settings = {});
+    void Unload();
+
+    bool IsLoaded() const { return !m_Heights.empty(); }
+    int GetWidth() const { return m_Width; }
+    int GetLength() const { return m_Length; }
+    const TerrainSettings& GetSettings() const { return m_Settings; }
+
+    // height in world units above the terrain origin
+    float GetHeight(int x, int z) const;
+    // bilinear height at local (x, z) in world units
+    float SampleHeight(float x, float z) const;
+
+    // shared with the collision shape; must stay alive and unchanged while it exists
+    const int16_t* GetHeightData() const { return m_Heights.data(); }
+    int16_t GetMinRaw() const { return m_MinRaw; }
+    int16_t GetMaxRaw() const { return m_MaxRaw; }
+
+    // Bullet centres heightfields on their AABB; this is that centre relative to
+    // the terrain origin, i.e. where the static body has to be placed.
+    Vector3 GetCollisionCenter() const;
+
+    // pick LODs, rebuild at most rebuildBudget stale chunks, draw visible chunks
+    void Draw(const Camera3D& camera, const Vector3& position, Color tint);
+
+    Material& GetMaterial() { return m_Material; }
+    int GetDrawCalls() const { return m_DrawCalls; }
+
+  private:
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    struct Chunk {
+      int x0 = 0, z0 = 0;       // first sample
+      int quadsX = 0, quadsZ = 0;
+      BoundingBox bounds{};     // local space
+      int lod = 0;
+      int key = -1;             // lod and edge stitching of the uploaded mesh
+      Mesh mesh{};
+      bool hasMesh = false;
+    };
+
+    void BuildChunks();
+    void BuildChunkMesh(Chunk& chunk, const int edgeLods[4]);
+    void ReleaseChunkMesh(Chunk& chunk);
+    float EdgeHeight(int x, int z, int along, int start, int length, int step, bool alongX) const;
+    Vector3 SampleNormal(int x, int z) const;
+
+  private:
+    std::vector<int16_t> m_Heights;
+    int m_Width = 0;
+    int m_Length = 0;
+    int16_t m_MinRaw = 0;
+    int16_t m_MaxRaw = 0;
+    TerrainSettings m_Settings;
+
+    std::vector<Chunk> m_Chunks;
+    int m_ChunksX = 0;
+    int m_ChunksZ = 0;
+    Material m_Material{};
+    bool m_HasMaterial = false;
+    int m_DrawCalls = 0;
+  };
+}
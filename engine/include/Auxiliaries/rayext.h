@@ -1,5 +1,6 @@
 #pragma once
 #include "raymath.h"
+#include "rlgl.h"
 #include "repch.h"
 
 inline static void DrawCameraFrustum(const Camera3D &cam, float nearDist, float farDist, Color col)
@@ -91,3 +92,51 @@ inline static void DrawCameraFrustum(const Camera3D &cam, float nearDist, float
     DrawSphere(nearCenter, 0.02f, col);
     DrawSphere(farCenter, 0.02f, col);
 }
+
+// View frustum as 6 planes (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+struct Frustum {
+    Vector4 planes[6];
+};
+
+// Builds the frustum raylib renders with for `cam` (same near/far as BeginMode3D).
+inline static Frustum GetCameraFrustum(const Camera3D &cam, float aspect)
+{
+    Matrix view = MatrixLookAt(cam.position, cam.target, cam.up);
+    Matrix proj;
+    if (cam.projection == CAMERA_PERSPECTIVE) {
+        proj = MatrixPerspective(cam.fovy * DEG2RAD, aspect, RL_CULL_DISTANCE_NEAR, RL_CULL_DISTANCE_FAR);
+    } else {
+        float top = cam.fovy / 2.0f;
+        float right = top * aspect;
+        proj = MatrixOrtho(-right, right, -top, top, RL_CULL_DISTANCE_NEAR, RL_CULL_DISTANCE_FAR);
+    }
+    Matrix m = MatrixMultiply(view, proj);
+
+    // Gribb/Hartmann: rows of the combined matrix (raylib stores column-major)
+    const Vector4 r0 = { m.m0, m.m4, m.m8,  m.m12 };
+    const Vector4 r1 = { m.m1, m.m5, m.m9,  m.m13 };
+    const Vector4 r2 = { m.m2, m.m6, m.m10, m.m14 };
+    const Vector4 r3 = { m.m3, m.m7, m.m11, m.m15 };
+
+    Frustum f;
+    f.planes[0] = { r3.x + r0.x, r3.y + r0.y, r3.z + r0.z, r3.w + r0.w }; // left
+    f.planes[1] = { r3.x - r0.x, r3.y - r0.y, r3.z - r0.z, r3.w - r0.w }; // right
+    f.planes[2] = { r3.x + r1.x, r3.y + r1.y, r3.z + r1.z, r3.w + r1.w }; // bottom
+    f.planes[3] = { r3.x - r1.x, r3.y - r1.y, r3.z - r1.z, r3.w - r1.w }; // top
+    f.planes[4] = { r3.x + r2.x, r3.y + r2.y, r3.z + r2.z, r3.w + r2.w }; // near
+    f.planes[5] = { r3.x - r2.x, r3.y - r2.y, r3.z - r2.z, r3.w - r2.w }; // far
+    return f;
+}
+
+// Conservative AABB test: false only if the box is fully outside one plane.
+inline static bool FrustumIntersectsBox(const Frustum &f, const BoundingBox &box)
+{
+    for (const Vector4 &p : f.planes) {
+        // corner furthest along the plane normal
+        const float x = p.x >= 0.0f ? box.max.x : box.min.x;
+        const float y = p.y >= 0.0f ? box.max.y : box.min.y;
+        const float z = p.z >= 0.0f ? box.max.z : box.min.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) return false;
+    }
+    return true;
+}
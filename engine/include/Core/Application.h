@@ -5,6 +5,7 @@
 #include "Auxiliaries/Assets.h"
 #include "LayerStack.h"
 #include "ImGuiLayer.h"
+#include "TickScheduler.h"
 
 int main(int argc, char** argv);
 
@@ -30,6 +31,8 @@ public:
  void PopLayer(Layer* layer);
  ImGuiLayer* GetImGuiLayer() { return m_ImGuiLayer;}
  AssetRegistry& GetAssets() { return *m_Assets;}
+ // tick groups for layers, ticked every frame before the layers update
+ TickScheduler& GetTicks() { return m_Ticks; }
 
  void Close();
 
@@ -49,6 +52,7 @@ private:
  bool m_Running = true;
  bool m_Minimized = false;
  LayerStack m_LayerStack;
+ TickScheduler m_Ticks;
  std::queue<LayerAction> m_LayerActionQueue;        
 private:
     friend int ::main(int argc, char** argv);
@@ -3,6 +3,7 @@
 #include <imgui.h>
 #include <imgui_internal.h>
 #include "Config.h"
+#include "Auxiliaries/Physics.h"
 // ------------------------
 // Small UI helpers
 // ------------------------
@@ -95,3 +96,31 @@ static bool DrawVec3Control(const char* label, Vector3& values,
   ImGui::PopID(); // label
   return changed;
 }
+
+// Physics3D counters and Bullet profile phases for the last step
+static void DrawPhysicsStats(const RE::PhysicsStats& stats)
+{
+  ImGui::Begin("Physics Stats");
+
+  ImGui::Text("Step: %.3f ms (%d substeps)", stats.stepMs, stats.subSteps);
+  ImGui::Separator();
+  ImGui::Text("Broadphase pairs: %d", stats.broadphasePairs);
+  ImGui::Text("Manifolds: %d (%d touching, %d contacts)", stats.manifolds, stats.touchingManifolds, stats.contacts);
+  ImGui::Text("Islands: %d", stats.islands);
+  ImGui::Text("Bodies: %d active, %d sleeping, %d static", stats.activeBodies, stats.sleepingBodies, stats.staticBodies);
+  ImGui::Text("Triggers: %d (%d events)", stats.triggers, stats.triggerEvents);
+
+  ImGui::Separator();
+  if (stats.phases.empty()) {
+    ImGui::TextDisabled("No profile data (Bullet built with BT_NO_PROFILE?)");
+  }
+  for (const auto& phase : stats.phases) {
+    // Indent(0) would apply the style default, so skip it for the root
+    const float indent = phase.depth * 10.0f;
+    if (indent > 0.0f) ImGui::Indent(indent);
+    ImGui::Text("%s: %.3f ms (%d)", phase.name, phase.ms, phase.calls);
+    if (indent > 0.0f) ImGui::Unindent(indent);
+  }
+
+  ImGui::End();
+}
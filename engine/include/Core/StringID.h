@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Config.h"
+#include <cstdint>
+#include <string_view>
+
+namespace RE {
+
+  // 32-bit FNV-1a hash of a name. Stable across runs, so ids can be saved and
+  // compared against compile-time constants.
+  using StringID = uint32_t;
+
+  constexpr StringID HashString(std::string_view str) {
+    uint32_t hash = 2166136261u;
+    for (char c : str) {
+      hash ^= (uint8_t)c;
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  // Global, thread-safe table from StringID back to the text. Interning an already
+  // known name only hashes and looks up; nothing is allocated. Debug builds report
+  // two different strings hashing to the same id.
+  class StringInterner {
+  public:
+    static StringID Intern(std::string_view str);
+    // "" for ids that were never interned
+    static std::string_view Resolve(StringID id);
+  };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Config.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace RE {
+
+  // Fixed set of worker threads shared by the engine. The thread calling
+  // ParallelFor takes batches too, so nested calls from a worker cannot deadlock.
+  class ThreadPool {
+  public:
+    explicit ThreadPool(uint32_t workers = DefaultWorkerCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // engine-wide pool, created on first use
+    static ThreadPool& Get();
+    static uint32_t DefaultWorkerCount();
+
+    uint32_t GetWorkerCount() const { return (uint32_t)m_Workers.size(); }
+
+    // queue a task for any worker
+    void Submit(std::function<void()> task);
+
+    // Split [0, count) into batches of at least `minBatch` and call func(begin, end)
+    // for each; blocks until all batches are done. Runs inline when one batch suffices.
+    void ParallelFor(size_t count, size_t minBatch, const std::function<void(size_t, size_t)>& func);
+
+  private:
+    void WorkerLoop();
+
+  private:
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+  };
+}
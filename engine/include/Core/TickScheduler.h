@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Config.h"
+#include "StringID.h"
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace RE {
+
+  // When a periodic task runs next, in its scheduler's time base. Phase is a
+  // fraction of the period, so tasks of one rate can be spread across frames.
+  struct TickClock {
+    double next = 0.0;
+    double last = 0.0;
+
+    void Start(double now, double period, float phase) {
+      last = now;
+      next = now + period * phase;
+    }
+
+    bool Due(double now) const { return now >= next; }
+
+    // time since the previous run; moves `next` past `now` on the phase grid,
+    // so a late task runs once rather than catching up
+    float Advance(double now, double period) {
+      const float elapsed = (float)(now - last);
+      last = now;
+      next = period > 0.0 ? next + period * (std::floor((now - next) / period) + 1.0) : now;
+      return elapsed;
+    }
+
+    // phases 0, 0.618, 0.236, ... keep any number of tasks roughly evenly spread
+    static float SpreadPhase(uint32_t index) {
+      const double phase = index * 0.6180339887498949;
+      return (float)(phase - std::floor(phase));
+    }
+  };
+
+  struct TickGroupStats {
+    StringID name = 0;
+    float rate = 0.0f;      // Hz, 0 for every frame
+    float budgetMs = 0.0f;  // 0 for none
+    float usedMs = 0.0f;    // last Tick
+    uint32_t ran = 0;
+    uint32_t deferred = 0;  // due but pushed to the next frame by the budget
+  };
+
+  // Tick groups: callbacks that run at a group's rate instead of every frame.
+  // Each task keeps its own phase so a 10 Hz group spreads its tasks across
+  // frames. Tasks are run most overdue first. Once a group spends its
+  // millisecond budget in a frame, the rest of its due tasks wait for the
+  // next frame instead of causing a hitch. At least one task always runs.
+  //
+  // Application ticks one for layers before their OnUpdate; every Scene ticks
+  // its own from OnUpdateRuntime.
+  class TickScheduler {
+  public:
+    using TickGroupID = uint32_t;
+    using TickID = uint32_t;
+    using TickFn = std::function<void(float)>; // time since the task last ran
+
+    static constexpr TickGroupID EveryFrame = 0;
+
+    TickScheduler();
+
+    TickGroupID CreateGroup(std::string_view name, float rateHz, float budgetMs = 0.0f);
+    void SetGroupRate(TickGroupID group, float rateHz);
+    void SetGroupBudget(TickGroupID group, float budgetMs);
+
+    // phase in [0, 1) of the group's period; negative picks a spread one
+    TickID Register(TickGroupID group, TickFn fn, float phase = -1.0f);
+    void Unregister(TickID id);
+
+    void Tick(float dt);
+
+    // one entry per group, updated by Tick
+    const std::vector<TickGroupStats>& GetStats() const { return m_Stats; }
+
+  private:
+    struct Task {
+      TickID id = 0; // 0 once unregistered
+      TickClock clock;
+      TickFn fn;
+    };
+
+    struct Group {
+      double period = 0.0;
+      float budgetMs = 0.0f;
+      uint32_t spread = 0;
+      std::vector<Task> tasks;
+    };
+
+    struct Pending {
+      TickGroupID group;
+      Task task;
+      float phase;
+    };
+
+    void Add(Pending pending);
+    void RunGroup(size_t index);
+
+  private:
+    std::vector<Group> m_Groups;
+    std::vector<TickGroupStats> m_Stats;
+    double m_Time = 0.0;
+    TickID m_NextID = 1;
+    bool m_Ticking = false;
+    // registered while ticking, added once the frame's groups are done
+    std::vector<Pending> m_Pending;
+    std::vector<std::pair<double, uint32_t>> m_Due; // scratch: (next, task)
+  };
+}
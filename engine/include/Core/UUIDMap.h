@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Config.h"
+#include <cstdint>
+#include <vector>
+
+namespace RE {
+
+  // Open-addressing uint64 -> Value map for UUID lookups. Linear probing over a
+  // power-of-two key array kept apart from the values, so a probe only walks
+  // keys; erase shifts the run back instead of leaving tombstones. Key 0 marks
+  // an empty slot and is stored on the side.
+  template<typename Value>
+  class UUIDMap {
+  public:
+    explicit UUIDMap(Value missing = Value{}) : m_Missing(missing) {}
+
+    size_t Size() const { return m_Size + (m_HasZero ? 1 : 0); }
+
+    void Clear() {
+      m_Keys.assign(m_Keys.size(), 0);
+      m_Size = 0;
+      m_HasZero = false;
+    }
+
+    void Reserve(size_t count) {
+      size_t capacity = 16;
+      while (capacity * 3 < count * 4) capacity <<= 1; // keep load under 3/4
+      if (capacity > m_Keys.size()) Rehash(capacity);
+    }
+
+    // inserts or overwrites
+    void Insert(uint64_t key, Value value) {
+      if (key == 0) {
+	m_HasZero = true;
+	m_ZeroValue = value;
+	return;
+      }
+      if ((m_Size + 1) * 4 > m_Keys.size() * 3)
+	Rehash(m_Keys.empty() ? 16 : m_Keys.size() * 2);
+
+      size_t slot = Home(key);
+      while (m_Keys[slot] != 0 && m_Keys[slot] != key)
+	slot = (slot + 1) & m_Mask;
+      if (m_Keys[slot] == 0) ++m_Size;
+      m_Keys[slot] = key;
+      m_Values[slot] = value;
+    }
+
+    Value Find(uint64_t key) const {
+      if (key == 0) return m_HasZero ? m_ZeroValue : m_Missing;
+      if (m_Keys.empty()) return m_Missing;
+      for (size_t slot = Home(key);; slot = (slot + 1) & m_Mask) {
+	if (m_Keys[slot] == key) return m_Values[slot];
+	if (m_Keys[slot] == 0) return m_Missing;
+      }
+    }
+
+    // Batched lookups: the home slots of a block are prefetched before any of
+    // them is probed, so cache misses overlap instead of queueing.
+    void FindMany(const uint64_t* keys, size_t count, Value* out) const {
+      constexpr size_t BLOCK = 16;
+      for (size_t begin = 0; begin < count; begin += BLOCK) {
+	const size_t end = std::min(count, begin + BLOCK);
+#if defined(__GNUC__) || defined(__clang__)
+	if (!m_Keys.empty())
+	  for (size_t i = begin; i < end; ++i)
+	    __builtin_prefetch(&m_Keys[Home(keys[i])]);
+#endif
+	for (size_t i = begin; i < end; ++i)
+	  out[i] = Find(keys[i]);
+      }
+    }
+
+    // returns false if the key was not there
+    bool Erase(uint64_t key) {
+      if (key == 0) {
+	const bool had = m_HasZero;
+	m_HasZero = false;
+	return had;
+      }
+      if (m_Keys.empty()) return false;
+
+      size_t slot = Home(key);
+      while (m_Keys[slot] != key) {
+	if (m_Keys[slot] == 0) return false;
+	slot = (slot + 1) & m_Mask;
+      }
+
+      // backward shift: pull later members of the run into the hole when their
+      // home slot is not between the hole and their current slot
+      size_t hole = slot;
+      for (size_t next = (hole + 1) & m_Mask; m_Keys[next] != 0; next = (next + 1) & m_Mask) {
+	const size_t home = Home(m_Keys[next]);
+	if (((next - home) & m_Mask) >= ((next - hole) & m_Mask)) {
+	  m_Keys[hole] = m_Keys[next];
+	  m_Values[hole] = m_Values[next];
+	  hole = next;
+	}
+      }
+      m_Keys[hole] = 0;
+      --m_Size;
+      return true;
+    }
+
+  private:
+    // ids may be sequential when authored by hand, so mix before masking
+    size_t Home(uint64_t key) const {
+      key ^= key >> 33;
+      key *= 0xFF51AFD7ED558CCDull;
+      key ^= key >> 33;
+      return (size_t)key & m_Mask;
+    }
+
+    void Rehash(size_t capacity) {
+      std::vector<uint64_t> keys(capacity, 0);
+      std::vector<Value> values(capacity, m_Missing);
+      keys.swap(m_Keys);
+      values.swap(m_Values);
+      m_Mask = capacity - 1;
+      m_Size = 0;
+      for (size_t i = 0; i < keys.size(); ++i)
+	if (keys[i] != 0) Insert(keys[i], values[i]);
+    }
+
+  private:
+    std::vector<uint64_t> m_Keys;
+    std::vector<Value> m_Values;
+    size_t m_Mask = 0;
+    size_t m_Size = 0;
+    Value m_Missing;
+    Value m_ZeroValue{};
+    bool m_HasZero = false;
+  };
+}
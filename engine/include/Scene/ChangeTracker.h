@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Core/Config.h"
+#include <entt/entt.hpp>
+#include <vector>
+
+namespace RE {
+
+  namespace Changes {
+    constexpr uint8_t Added   = 1;
+    constexpr uint8_t Updated = 2; // patch/replace, or Scene::MarkChanged
+    constexpr uint8_t Removed = 4; // component removed or entity destroyed
+  }
+
+  // Entities whose component changed during one frame, each listed once with
+  // the OR of its Changes bits. An entity added and removed in the same frame
+  // carries both; a removed entity may already be gone from the registry.
+  class ChangeSet {
+  public:
+    const std::vector<entt::entity>& GetEntities() const { return m_Entities; }
+    size_t Size() const { return m_Entities.size(); }
+    bool Empty() const { return m_Entities.empty(); }
+
+    // Changes bits of `entity`, 0 if it did not change
+    uint8_t Get(entt::entity entity) const {
+      const uint32_t slot = Slot(entity);
+      return slot != Absent ? m_Flags[slot] : 0;
+    }
+
+    // fn(entity, changes) in the order the entities first changed
+    template<typename Fn>
+    void Each(Fn&& fn) const {
+      for (size_t i = 0; i < m_Entities.size(); ++i)
+	fn(m_Entities[i], m_Flags[i]);
+    }
+
+    void Mark(entt::entity entity, uint8_t changes) {
+      uint32_t slot = Slot(entity);
+      if (slot == Absent) {
+	const size_t index = entt::to_entity(entity);
+	if (index >= m_SlotOf.size()) m_SlotOf.resize(index + 1, Absent);
+	slot = (uint32_t)m_Entities.size();
+	m_Entities.push_back(entity);
+	m_Flags.push_back(0);
+	m_Next.push_back(m_SlotOf[index]);
+	m_SlotOf[index] = slot;
+      }
+      m_Flags[slot] |= changes;
+    }
+
+    // forgets only the listed entities, so clearing costs what the frame changed
+    void Clear() {
+      for (auto entity : m_Entities)
+	m_SlotOf[entt::to_entity(entity)] = Absent;
+      m_Entities.clear();
+      m_Flags.clear();
+      m_Next.clear();
+    }
+
+  private:
+    static constexpr uint32_t Absent = UINT32_MAX;
+
+    // an index recycled within the frame chains its versions, newest first
+    uint32_t Slot(entt::entity entity) const {
+      const size_t index = entt::to_entity(entity);
+      if (index >= m_SlotOf.size()) return Absent;
+      uint32_t slot = m_SlotOf[index];
+      while (slot != Absent && m_Entities[slot] != entity)
+	slot = m_Next[slot];
+      return slot;
+    }
+
+  private:
+    std::vector<entt::entity> m_Entities;
+    std::vector<uint8_t> m_Flags;
+    std::vector<uint32_t> m_Next;   // older entry with the same index
+    std::vector<uint32_t> m_SlotOf; // newest entry by entity index
+  };
+
+  // Collects one component type's construct/update/destroy signals. Scene owns
+  // these (Scene::TrackChanges) and swaps them at the start of every update.
+  class ChangeTracker {
+  public:
+    using Connector = void (*)(entt::registry&, ChangeTracker&);
+
+    explicit ChangeTracker(Connector connect) : m_Connect(connect) {}
+
+    template<typename T>
+    static void Connect(entt::registry& registry, ChangeTracker& tracker) {
+      registry.on_construct<T>().template connect<&ChangeTracker::OnAdded>(tracker);
+      registry.on_update<T>().template connect<&ChangeTracker::OnUpdated>(tracker);
+      registry.on_destroy<T>().template connect<&ChangeTracker::OnRemoved>(tracker);
+    }
+
+    template<typename T>
+    static void Disconnect(entt::registry& registry, ChangeTracker& tracker) {
+      registry.on_construct<T>().disconnect(&tracker);
+      registry.on_update<T>().disconnect(&tracker);
+      registry.on_destroy<T>().disconnect(&tracker);
+    }
+
+    // changes of the last full frame, frame-end command playback included
+    const ChangeSet& GetChanges() const { return m_Previous; }
+    // changes so far this frame
+    const ChangeSet& GetPending() const { return m_Current; }
+
+    void Mark(entt::entity entity, uint8_t changes) { m_Current.Mark(entity, changes); }
+
+    void NextFrame() {
+      std::swap(m_Previous, m_Current);
+      m_Current.Clear();
+    }
+
+    Connector GetConnector() const { return m_Connect; }
+
+  private:
+    void OnAdded(entt::registry&, entt::entity entity) { m_Current.Mark(entity, Changes::Added); }
+    void OnUpdated(entt::registry&, entt::entity entity) { m_Current.Mark(entity, Changes::Updated); }
+    void OnRemoved(entt::registry&, entt::entity entity) { m_Current.Mark(entity, Changes::Removed); }
+
+  private:
+    Connector m_Connect;
+    ChangeSet m_Current;
+    ChangeSet m_Previous;
+  };
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Scene/Entity.h"
+#include <entt/entt.hpp>
+#include <unordered_set>
+
+namespace RE {
+
+  // Entity as seen by a command buffer: either a live entity or a placeholder
+  // returned by CommandBuffer::Create, resolved when the buffer is played back.
+  // Placeholders are only meaningful in the buffer that created them.
+  struct DeferredEntity {
+    entt::entity handle = entt::null;
+    uint32_t placeholder = UINT32_MAX;
+
+    DeferredEntity() = default;
+    DeferredEntity(entt::entity entity) : handle(entity) {}
+
+    bool IsPlaceholder() const { return placeholder != UINT32_MAX; }
+  };
+
+  // Records entity/component changes without touching the registry so worker
+  // threads can edit the scene. Get one per thread from Scene::GetCommandBuffer();
+  // everything is applied by Scene::FlushCommandBuffers on the main thread.
+  //
+  // Playback order is deterministic: all creates first, then component commands,
+  // then destroys; within a phase commands are ordered by (sort key, producer,
+  // record order), component commands grouped by component type first. Unless
+  // SetSortKey gives one, a command's key is its target entity (or placeholder).
+  // The SystemScheduler makes each system the producer of what it records, so
+  // systems never tie on the thread they happened to run on. Only one producer
+  // touching the same key from several threads is left to thread order, and
+  // playback warns about it.
+  //
+  // Component commands of one type and op that follow each other in that order
+  // are applied as one range insert or remove.
+  class CommandBuffer {
+  public:
+    enum class Op : uint8_t { Create, Add, Replace, Remove, Destroy };
+
+    void SetSortKey(uint64_t key) { m_SortKey = key; m_HasSortKey = true; }
+    // back to keying commands by their target
+    void ClearSortKey() { m_HasSortKey = false; }
+    // stable id of whoever records next (0: none); clears the sort key
+    void SetProducer(uint32_t producer) { m_Producer = producer; m_HasSortKey = false; }
+
+    DeferredEntity Create(std::string_view name = std::string_view()) {
+      DeferredEntity entity;
+      entity.placeholder = (uint32_t)m_Created.size();
+      m_Created.push_back(entt::null);
+      m_Names.push_back(name.empty() ? 0 : StringInterner::Intern(name));
+      Push(Op::Create, entity, UINT32_MAX, (uint32_t)m_Names.size() - 1);
+      return entity;
+    }
+
+    void Destroy(DeferredEntity entity) {
+      Push(Op::Destroy, entity, UINT32_MAX, 0);
+    }
+
+    template<typename T, typename... Args>
+    void Add(DeferredEntity entity, Args&&... args) {
+      Record<T>(Op::Add, entity, std::forward<Args>(args)...);
+    }
+
+    // add or overwrite
+    template<typename T, typename... Args>
+    void Replace(DeferredEntity entity, Args&&... args) {
+      Record<T>(Op::Replace, entity, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void Remove(DeferredEntity entity) {
+      auto& pool = GetPool<T>();
+      Push(Op::Remove, entity, pool.slot, 0);
+    }
+
+    bool Empty() const { return m_Commands.empty(); }
+
+  private:
+    struct Command {
+      uint64_t key;
+      uint32_t producer;
+      uint32_t seq;
+      Op op;
+      DeferredEntity target;
+      uint32_t pool;   // component pool slot, UINT32_MAX for create/destroy
+      uint32_t index;  // value index in the pool, or name index for create
+    };
+
+    // one component command of a run, in whichever buffer recorded it
+    struct RunItem {
+      CommandBuffer* buffer;
+      uint32_t seq;
+    };
+
+    struct PoolBase {
+      uint32_t slot = 0;
+      entt::id_type type = 0;
+      virtual ~PoolBase() = default;
+      // commands of this pool's type and one op, from any buffer
+      virtual void ApplyRun(Scene& scene, Op op, const RunItem* items, size_t count) = 0;
+      virtual void Clear() = 0;
+    };
+
+    template<typename T>
+    struct Pool : PoolBase {
+      std::vector<T> values;
+
+      void ApplyRun(Scene& scene, Op op, const RunItem* items, size_t count) override {
+	CommandBuffer::ApplyRun<T>(scene, op, items, count);
+      }
+
+      void Clear() override { values.clear(); }
+    };
+
+    template<typename T, typename... Args>
+    static T MakeComponent(Args&&... args) {
+      if constexpr (std::is_constructible_v<T, Args...>)
+	return T(std::forward<Args>(args)...);
+      else
+	return T{ std::forward<Args>(args)... };
+    }
+
+    template<typename T, typename... Args>
+    void Record(Op op, DeferredEntity entity, Args&&... args) {
+      auto& pool = GetPool<T>();
+      pool.values.push_back(MakeComponent<T>(std::forward<Args>(args)...));
+      Push(op, entity, pool.slot, (uint32_t)pool.values.size() - 1);
+    }
+
+    template<typename T>
+    Pool<T>& GetPool() {
+      const auto id = entt::type_hash<T>::value();
+      auto it = m_PoolIndex.find(id);
+      if (it == m_PoolIndex.end()) {
+	auto pool = CreateScope<Pool<T>>();
+	pool->slot = (uint32_t)m_Pools.size();
+	pool->type = id;
+	it = m_PoolIndex.emplace(id, pool->slot).first;
+	m_Pools.push_back(std::move(pool));
+      }
+      return static_cast<Pool<T>&>(*m_Pools[it->second]);
+    }
+
+    void Push(Op op, DeferredEntity entity, uint32_t pool, uint32_t index) {
+      // placeholders above every live entity id
+      const uint64_t key = m_HasSortKey ? m_SortKey
+	: entity.IsPlaceholder() ? (1ull << 63) | entity.placeholder
+	: (uint64_t)entt::to_integral(entity.handle);
+      m_Commands.push_back({ key, m_Producer, (uint32_t)m_Commands.size(), op, entity, pool, index });
+    }
+
+    entt::entity Resolve(DeferredEntity entity) const {
+      return entity.IsPlaceholder() ? m_Created[entity.placeholder] : entity.handle;
+    }
+
+    // Runs on the main thread during Scene::FlushCommandBuffers. Removes go out
+    // with one range remove. Adds, and replaces of entities without T, go in
+    // with one insert; replaces of entities that have T are applied one by one.
+    template<typename T>
+    static void ApplyRun(Scene& scene, Op op, const RunItem* items, size_t count) {
+      auto& registry = scene.m_Registry;
+      std::vector<entt::entity> entities;
+      entities.reserve(count);
+
+      if (op == Op::Remove) {
+	for (size_t i = 0; i < count; ++i)
+	  entities.push_back(items[i].buffer->Resolve(items[i].buffer->m_Commands[items[i].seq].target));
+	// skips entities without T, dead ones included
+	registry.remove<T>(entities.begin(), entities.end());
+	return;
+      }
+
+      const auto& storage = registry.storage<T>();
+      std::vector<T> values;
+      values.reserve(count);
+      std::unordered_set<entt::entity> queued;
+      for (size_t i = 0; i < count; ++i) {
+	CommandBuffer& buffer = *items[i].buffer;
+	const Command& cmd = buffer.m_Commands[items[i].seq];
+	const entt::entity entity = buffer.Resolve(cmd.target);
+	T& value = static_cast<Pool<T>&>(*buffer.m_Pools[cmd.pool]).values[cmd.index];
+	if (!registry.valid(entity)) continue;
+
+	const bool pending = queued.count(entity) != 0;
+	if (!pending && !storage.contains(entity)) {
+	  queued.insert(entity);
+	  entities.push_back(entity);
+	  values.push_back(std::move(value));
+	} else if (op == Op::Add) {
+	  TraceLog(LOG_ERROR, "Entity already has component!");
+	} else {
+	  // a second replace of a queued entity lands on top of the first
+	  if (pending) {
+	    InsertRun(scene, entities, values);
+	    queued.clear();
+	  }
+	  scene.OnComponentAdded<T>(Entity(entity, &scene), registry.replace<T>(entity, std::move(value)));
+	}
+      }
+      InsertRun(scene, entities, values);
+    }
+
+    template<typename T>
+    static void InsertRun(Scene& scene, std::vector<entt::entity>& entities, std::vector<T>& values) {
+      if (entities.empty()) return;
+      auto& registry = scene.m_Registry;
+      registry.insert<T>(entities.begin(), entities.end(), values.begin());
+      for (auto entity : entities)
+	scene.OnComponentAdded<T>(Entity(entity, &scene), registry.get<T>(entity));
+      entities.clear();
+      values.clear();
+    }
+
+    void Clear() {
+      m_Commands.clear();
+      m_Created.clear();
+      m_Names.clear();
+      for (auto& pool : m_Pools) pool->Clear();
+      m_SortKey = 0;
+      m_HasSortKey = false;
+      m_Producer = 0;
+    }
+
+  private:
+    uint64_t m_SortKey = 0;
+    bool m_HasSortKey = false;
+    uint32_t m_Producer = 0;
+    std::vector<Command> m_Commands;
+    std::vector<entt::entity> m_Created;
+    std::vector<StringID> m_Names;   // 0: default name
+    std::vector<Scope<PoolBase>> m_Pools;
+    std::unordered_map<entt::id_type, uint32_t> m_PoolIndex;
+    friend class Scene;
+  };
+}
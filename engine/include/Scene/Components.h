@@ -1,31 +1,45 @@
 #pragma once
 
 #include "Core/UUID.h"
+#include "Core/StringID.h"
 #include "raylib.h"
 #include "Auxiliaries/Assets.h"
+#include "Auxiliaries/Physics.h"
+#include "Auxiliaries/Terrain.h"
 #include <btBulletDynamicsCommon.h>
+#include <entt/entt.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 
 namespace RE {
 
+  class Entity;
+  class ScriptPoolBase;
+  // defined in Scene/NativeScript.h, which Bind's callers include
+  template<typename T> Scope<ScriptPoolBase> CreateScriptPool();
+
     struct IDComponent
   {
     UUID ID;
 
     IDComponent() = default;
     IDComponent(const IDComponent&) = default;
+    IDComponent(const UUID& id)
+      : ID(id) {}
   };
 
+  // interned name; Scene::FindByName indexes it
   struct TagComponent
   {
-    std::string Tag;
+    StringID Tag = 0;
 
     TagComponent() = default;
     TagComponent(const TagComponent&) = default;
-    TagComponent(const std::string& tag)
-      : Tag(tag) {}
+    TagComponent(std::string_view tag)
+      : Tag(StringInterner::Intern(tag)) {}
+
+    std::string_view GetName() const { return StringInterner::Resolve(Tag); }
   };
 
   struct TransformComponent
@@ -68,17 +82,32 @@ namespace RE {
     int animsCount = 0;
     unsigned int animIndex = 0;
     unsigned int animCurrentFrame = 0;
-    void AddAnimation(const std::string &name, ModelAnimation *animation) {
-      animations[name] = animation;
+    void AddAnimation(std::string_view name, ModelAnimation *animation) {
+      AddAnimation(StringInterner::Intern(name), animation);
+    }
+    void AddAnimation(StringID name, ModelAnimation *animation) {
+      for (auto &clip : animations)
+	if (clip.first == name) {
+	  clip.second = animation;
+	  return;
+	}
+      animations.emplace_back(name, animation);
     }
 
-    void PlayAnimation(const std::string &name) {
-      playingAnim = animations[name];
+    void PlayAnimation(std::string_view name) {
+      PlayAnimation(HashString(name));
+    }
+    void PlayAnimation(StringID name) {
+      playingAnim = nullptr;
+      for (const auto &clip : animations)
+	if (clip.first == name)
+	  playingAnim = clip.second;
     }
     AnimationComponent() = default;
     AnimationComponent(const AnimationComponent&) = default;
   private:
-    std::map<std::string, ModelAnimation*> animations;
+    // a handful of clips: a flat list of ids beats any map
+    std::vector<std::pair<StringID, ModelAnimation*>> animations;
   };
 
   struct Camera3DComponent
@@ -115,6 +144,15 @@ namespace RE {
     SkyboxComponent(const SkyboxComponent&) = default;
   };
 
+  struct TerrainComponent {
+    Ref<Terrain> terrain;
+    Color color = WHITE;
+    bool collision = true;     // static heightfield body while playing
+    void *body = nullptr;
+    TerrainComponent() = default;
+    TerrainComponent(const TerrainComponent&) = default;
+  };
+
   // Physics 3D
   enum class BodyType { Static, Dynamic, Kinematic };
   struct Shape {
@@ -126,16 +164,23 @@ namespace RE {
     Vector3 boxSize;
     Vector3 planeSize;
     float radius;
+
+    // compound children and their pose relative to the parent body
+    std::vector<Shape> children;
+    Vector3 localTranslation = {0, 0, 0};
+    Vector3 localRotation = {0, 0, 0};
   public:
     bool operator!() const {
-      return !box && !sphere; // returns true if Shape is null
+      return !box && !sphere && !compound; // returns true if Shape is null
     }
   protected:
     bool box = false;
     bool sphere = false;
     bool plane = false;
     bool mesh = false;
+    bool compound = false;
     friend class Scene;
+    friend class SceneSerializer;
   };
 
   struct BoxShape : Shape {
@@ -158,17 +203,86 @@ namespace RE {
       plane = true;
     }
   };
+  // Several convex children on one body (btCompoundShape with a dynamic AABB tree).
+  // Box, sphere and nested compound children; AddChild refuses planes, whose
+  // infinite bounds would break the tree.
+  struct CompoundShape : Shape {
+    CompoundShape() {
+      compound = true;
+    }
+
+    CompoundShape &AddChild(const Shape &child, const Vector3 &offset = {0, 0, 0},
+                            const Vector3 &rotation = {0, 0, 0}) {
+      if (!child) {
+        TraceLog(LOG_ERROR, "CompoundShape: only box, sphere and compound children are supported");
+        return *this;
+      }
+      Shape &added = children.emplace_back(child);
+      added.localTranslation = offset;
+      added.localRotation = rotation;
+      return *this;
+    }
+  };
+
   struct RigidbodyComponent {
     void *body;
     Shape shape;
     BodyType type;
+    // collision layer; static bodies left on Default are placed on CollisionLayers::Static
+    CollisionLayer layer = CollisionLayers::Default;
     RigidbodyComponent() = default;
     RigidbodyComponent(const RigidbodyComponent &) = default;
+  };
 
-  private:
-    Vector3 savedTranslation;
-    Vector3 savedRotation;
-    Vector3 savedScale;
-    friend class Scene;
+  // Trigger volume: a ghost object without contact response. Callbacks fire from
+  // Scene::PhysicsUpdate only when an overlap starts or ends.
+  struct TriggerComponent {
+    void *ghost = nullptr;
+    Shape shape;
+    CollisionLayer layer = CollisionLayers::Trigger;
+    std::function<void(Entity self, Entity other)> OnEnter;
+    std::function<void(Entity self, Entity other)> OnExit;
+    TriggerComponent() = default;
+    TriggerComponent(const TriggerComponent &) = default;
   };
+
+  // Scenery that never moves. Scene::BakeStaticGeometry merges the models of
+  // static entities (these, and static rigidbodies) unless batch is false.
+  struct StaticComponent {
+    bool batch = true;
+    StaticComponent() = default;
+    StaticComponent(const StaticComponent &) = default;
+  };
+
+  // Native C++ behaviour: Bind<T>() with T derived from ScriptableEntity
+  // (Scene/NativeScript.h). From OnRuntimeStart to OnRuntimeStop the Scene
+  // keeps one T per entity in a pool per script type and updates pool by pool.
+  struct NativeScriptComponent {
+    static constexpr uint32_t NullSlot = ~0u;
+
+    entt::id_type type = 0;
+    Scope<ScriptPoolBase> (*CreatePool)() = nullptr;
+    uint32_t slot = NullSlot; // instance in the type's pool, while running
+    entt::id_type runningType = 0; // type that instance was created with
+
+    NativeScriptComponent() = default;
+    NativeScriptComponent(const NativeScriptComponent &) = default;
+
+    template<typename T>
+    NativeScriptComponent &Bind() {
+      type = entt::type_hash<T>::value();
+      CreatePool = &CreateScriptPool<T>;
+      return *this;
+    }
+  };
+
+  template<typename... Component>
+  struct ComponentGroup {};
+
+  // every component Scene::Copy clones; add new components here
+  using AllComponents = ComponentGroup<IDComponent, TagComponent, TransformComponent,
+				       ModelComponent, AnimationComponent, Camera3DComponent,
+				       CubeComponent, SphereComponent, PlaneComponent,
+				       SkyboxComponent, TerrainComponent, RigidbodyComponent,
+				       TriggerComponent, StaticComponent, NativeScriptComponent>;
 }
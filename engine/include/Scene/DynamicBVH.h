@@ -0,0 +1,204 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Core/UUIDMap.h"
+#include "Auxiliaries/rayext.h"
+#include <entt/entt.hpp>
+#include <cfloat>
+#include <vector>
+
+namespace RE {
+
+  // Dynamic AABB tree over entity bounds. Leaves store a box fattened by a
+  // margin, so an entity moving inside it costs nothing; a bigger move
+  // reinserts the leaf and tree rotations keep the height logarithmic.
+  // Queries test the tight box at the leaves.
+  class DynamicBVH {
+  public:
+    static constexpr int32_t NullNode = -1;
+
+    explicit DynamicBVH(float margin = 0.25f) : m_Margin(margin) {}
+
+    // inserts or moves an entity; true if the tree had to change shape
+    bool Update(entt::entity entity, const BoundingBox& box);
+    bool Remove(entt::entity entity);
+    void Clear();
+
+    bool Contains(entt::entity entity) const { return m_LeafOf.Find(Key(entity)) != NullNode; }
+    // tight box last given to Update; the entity must be in the tree
+    const BoundingBox& GetBounds(entt::entity entity) const { return m_Nodes[m_LeafOf.Find(Key(entity))].tight; }
+    // every entity in the tree, packed, in no particular order
+    const std::vector<entt::entity>& GetEntities() const { return m_Entities; }
+    size_t Size() const { return m_Entities.size(); }
+    int GetHeight() const { return m_Root == NullNode ? 0 : m_Nodes[m_Root].height; }
+
+    // fn(entity) for every box overlapping `box`
+    template<typename Fn>
+    void QueryBox(const BoundingBox& box, Fn&& fn) const {
+      Traverse([&box](const BoundingBox& b) { return Overlaps(b, box); }, fn);
+    }
+
+    // fn(entity) for every box touching the sphere
+    template<typename Fn>
+    void QuerySphere(const Vector3& center, float radius, Fn&& fn) const {
+      const float radiusSq = radius * radius;
+      Traverse([&](const BoundingBox& b) { return DistanceSq(b, center) <= radiusSq; }, fn);
+    }
+
+    // fn(entity) for every box not fully outside the frustum. Subtrees found
+    // inside a plane skip that plane further down.
+    template<typename Fn>
+    void QueryFrustum(const Frustum& frustum, Fn&& fn) const {
+      if (m_Root == NullNode) return;
+      struct Item { int32_t node; uint8_t planes; };
+      Item stack[STACK_SIZE];
+      int top = 0;
+      stack[top++] = { m_Root, 0x3F };
+      while (top > 0) {
+	const Item item = stack[--top];
+	const Node& node = m_Nodes[item.node];
+	const uint8_t planes = ClipPlanes(frustum, node.IsLeaf() ? node.tight : node.box, item.planes);
+	if (planes == OUTSIDE) continue;
+	if (node.IsLeaf())
+	  fn(node.entity);
+	else {
+	  stack[top++] = { node.child1, planes };
+	  stack[top++] = { node.child2, planes };
+	}
+      }
+    }
+
+    // fn(entity, distance) for every box the ray enters within maxDistance,
+    // nearer child first. fn returns the new maxDistance: return `distance` to
+    // keep only closer hits, the old maxDistance to see them all, 0 to stop.
+    template<typename Fn>
+    void RayCast(const Ray& ray, float maxDistance, Fn&& fn) const {
+      if (m_Root == NullNode) return;
+      const Vector3 inv = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+      int32_t stack[STACK_SIZE];
+      int top = 0;
+      stack[top++] = m_Root;
+      while (top > 0) {
+	const Node& node = m_Nodes[stack[--top]];
+	float t;
+	if (!RayBox(ray.position, inv, node.IsLeaf() ? node.tight : node.box, maxDistance, t)) continue;
+	if (node.IsLeaf()) {
+	  maxDistance = fn(node.entity, t);
+	  if (maxDistance <= 0.0f) return;
+	  continue;
+	}
+	float t1, t2;
+	const bool hit1 = RayBox(ray.position, inv, m_Nodes[node.child1].box, maxDistance, t1);
+	const bool hit2 = RayBox(ray.position, inv, m_Nodes[node.child2].box, maxDistance, t2);
+	// the nearer child goes on top
+	if (hit1 && hit2) {
+	  stack[top++] = t1 <= t2 ? node.child2 : node.child1;
+	  stack[top++] = t1 <= t2 ? node.child1 : node.child2;
+	} else if (hit1)
+	  stack[top++] = node.child1;
+	else if (hit2)
+	  stack[top++] = node.child2;
+      }
+    }
+
+    // up to k entities whose boxes are nearest to `point`, closest first
+    size_t QueryNearest(const Vector3& point, size_t k, std::vector<entt::entity>& out,
+			float maxDistance = FLT_MAX) const;
+
+  private:
+    // the tree stays balanced, so its height is about 1.44 log2(n)
+    static constexpr int STACK_SIZE = 128;
+    static constexpr uint8_t OUTSIDE = 0xFF;
+
+    struct Node {
+      BoundingBox box;    // fattened for leaves, union of the children otherwise
+      BoundingBox tight;  // leaves only
+      int32_t parent = NullNode;   // next free node while on the free list
+      int32_t child1 = NullNode;
+      int32_t child2 = NullNode;
+      int32_t height = 0;          // 0 for leaves, -1 while free
+      entt::entity entity = entt::null;
+      uint32_t slot = 0;           // index in m_Entities
+      bool IsLeaf() const { return child1 == NullNode; }
+    };
+
+    static uint64_t Key(entt::entity entity) { return (uint64_t)entt::to_integral(entity); }
+
+    template<typename Test, typename Fn>
+    void Traverse(Test&& test, Fn& fn) const {
+      if (m_Root == NullNode) return;
+      int32_t stack[STACK_SIZE];
+      int top = 0;
+      stack[top++] = m_Root;
+      while (top > 0) {
+	const Node& node = m_Nodes[stack[--top]];
+	if (node.IsLeaf()) {
+	  if (test(node.tight)) fn(node.entity);
+	} else if (test(node.box)) {
+	  stack[top++] = node.child1;
+	  stack[top++] = node.child2;
+	}
+      }
+    }
+
+    static bool Overlaps(const BoundingBox& a, const BoundingBox& b) {
+      return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+	     a.min.y <= b.max.y && a.max.y >= b.min.y &&
+	     a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    static bool Encloses(const BoundingBox& outer, const BoundingBox& inner) {
+      return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+	     outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+    }
+
+    static float DistanceSq(const BoundingBox& box, const Vector3& p) {
+      const float dx = std::max(std::max(box.min.x - p.x, 0.0f), p.x - box.max.x);
+      const float dy = std::max(std::max(box.min.y - p.y, 0.0f), p.y - box.max.y);
+      const float dz = std::max(std::max(box.min.z - p.z, 0.0f), p.z - box.max.z);
+      return dx * dx + dy * dy + dz * dz;
+    }
+
+    // slab test; t is where the ray enters (0 if it starts inside)
+    static bool RayBox(const Vector3& origin, const Vector3& inv, const BoundingBox& box, float maxT, float& t) {
+      float tx1 = (box.min.x - origin.x) * inv.x, tx2 = (box.max.x - origin.x) * inv.x;
+      float ty1 = (box.min.y - origin.y) * inv.y, ty2 = (box.max.y - origin.y) * inv.y;
+      float tz1 = (box.min.z - origin.z) * inv.z, tz2 = (box.max.z - origin.z) * inv.z;
+      const float tmin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+      const float tmax = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxT));
+      t = tmin;
+      return tmin <= tmax;
+    }
+
+    // planes the box still straddles, or OUTSIDE
+    static uint8_t ClipPlanes(const Frustum& frustum, const BoundingBox& box, uint8_t planes) {
+      for (int i = 0; i < 6; ++i) {
+	if (!(planes & (1u << i))) continue;
+	const Vector4& p = frustum.planes[i];
+	const float far = p.x * (p.x >= 0.0f ? box.max.x : box.min.x) +
+			  p.y * (p.y >= 0.0f ? box.max.y : box.min.y) +
+			  p.z * (p.z >= 0.0f ? box.max.z : box.min.z) + p.w;
+	if (far < 0.0f) return OUTSIDE;
+	const float near = p.x * (p.x >= 0.0f ? box.min.x : box.max.x) +
+			   p.y * (p.y >= 0.0f ? box.min.y : box.max.y) +
+			   p.z * (p.z >= 0.0f ? box.min.z : box.max.z) + p.w;
+	if (near >= 0.0f) planes &= ~(1u << i);
+      }
+      return planes;
+    }
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t node);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t node);
+
+  private:
+    std::vector<Node> m_Nodes;
+    int32_t m_Root = NullNode;
+    int32_t m_FreeList = NullNode;
+    float m_Margin;
+    std::vector<entt::entity> m_Entities;
+    UUIDMap<int32_t> m_LeafOf{ NullNode };
+  };
+}
@@ -45,6 +45,13 @@ namespace RE {
       return m_Scene->m_Registry.get<T>(m_EntityHandle);
     }
 
+    // in-place edit that change tracking sees: fn(T&)
+    template<typename T, typename Fn>
+      T& PatchComponent(Fn&& fn)
+      {
+	return m_Scene->m_Registry.patch<T>(m_EntityHandle, std::forward<Fn>(fn));
+      }
+
     template <typename T> bool HasComponent() {
       if(m_EntityHandle == entt::null){
             TraceLog(LOG_ERROR, "Entity handle is null!");
@@ -66,7 +73,8 @@ namespace RE {
     operator uint32_t() const { return (uint32_t)m_EntityHandle; }
 
     UUID GetUUID() { return GetComponent<IDComponent>().ID; }
-    const std::string& GetName() { return GetComponent<TagComponent>().Tag; }
+    std::string_view GetName() { return GetComponent<TagComponent>().GetName(); }
+    void SetName(std::string_view name) { m_Scene->SetEntityName(m_EntityHandle, name); }
 
     bool operator==(const Entity& other) const
       {
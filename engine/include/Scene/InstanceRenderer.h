@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "raylib.h"
+#include <unordered_map>
+#include <vector>
+
+namespace RE {
+
+  struct ModelAsset;
+  struct ShaderAsset;
+
+  // Draws entities that share a ModelAsset with one DrawMeshInstanced per mesh
+  // (and so per material) instead of a DrawModelEx each. Between Begin and
+  // Flush, Add collects world matrices per asset; the per-instance tint rides
+  // in the matrix's bottom row, which Data/Shaders/instanced.vs restores.
+  // The shader is an asset of the application's AssetRegistry, loaded by the
+  // first Add and unloaded with the other assets.
+  //
+  // Meshes whose material has its own shader cannot be instanced with ours:
+  // Add refuses their asset and the caller draws it as before.
+  class InstanceRenderer {
+  public:
+    void Begin();
+    bool Add(const ModelAsset& asset, const Matrix& world, Color tint);
+    void Flush();
+
+    // last Flush
+    uint32_t GetDrawCalls() const { return m_DrawCalls; }
+    uint32_t GetInstanceCount() const { return m_InstanceCount; }
+
+  private:
+    struct Batch {
+      const ModelAsset* asset = nullptr;
+      std::vector<Matrix> instances;
+    };
+
+    static constexpr uint32_t Refused = ~0u;
+    static bool Instanceable(const ModelAsset& asset);
+    bool AcquireShader();
+
+  private:
+    std::vector<Batch> m_Batches;  // [0, m_Used) this frame; the rest keep their capacity
+    size_t m_Used = 0;
+    std::unordered_map<const ModelAsset*, uint32_t> m_BatchIndex; // Refused for assets drawn as before
+    uint32_t m_DrawCalls = 0;
+    uint32_t m_InstanceCount = 0;
+    Ref<ShaderAsset> m_Shader;
+    bool m_ShaderTried = false;
+  };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Scene/Entity.h"
+#include <type_traits>
+#include <vector>
+
+namespace RE {
+
+  // Base of native scripts. The hooks are not virtual: the script pool calls
+  // them on the concrete type, so declare the ones you need as public members
+  //   void OnCreate();  void OnUpdate(float dt);  void OnDestroy();
+  // Scripts are stored by value, one array per type, and move when the array
+  // is compacted: keep no pointers to them across frames.
+  class ScriptableEntity {
+  public:
+    void OnCreate() {}
+    void OnUpdate(float dt) {}
+    void OnDestroy() {}
+
+    Entity GetEntity() const { return m_Entity; }
+
+    template<typename T>
+    T& GetComponent() { return m_Entity.GetComponent<T>(); }
+
+    template<typename T>
+    bool HasComponent() { return m_Entity.HasComponent<T>(); }
+
+  private:
+    Entity m_Entity;
+    template<typename> friend class ScriptPool;
+  };
+
+  // The instances of one script type. One virtual call per pool and frame;
+  // inside it the hooks are plain calls over contiguous instances.
+  class ScriptPoolBase {
+  public:
+    virtual ~ScriptPoolBase() = default;
+
+    // constructs an instance; OnCreate waits for Start
+    virtual uint32_t Add(Entity entity) = 0;
+    // OnCreate for everything added since the last Start
+    virtual void Start() = 0;
+    virtual void Update(float dt) = 0;
+    // OnDestroy now; the slot is reclaimed by Compact
+    virtual void Destroy(uint32_t slot) = 0;
+    // drops destroyed slots keeping order and points moved components at
+    // their new slot; never while the pool is being iterated
+    virtual void Compact(entt::registry& registry) = 0;
+    // OnDestroy for every live instance, then empties the pool
+    virtual void Clear() = 0;
+    virtual ScriptableEntity* Get(uint32_t slot) = 0;
+
+    size_t Size() const { return m_Entities.size() - m_Dead; }
+
+    // linear; for the rare lookup by entity
+    uint32_t Find(entt::entity entity) const {
+      for (size_t i = 0; i < m_Entities.size(); ++i)
+	if (m_Entities[i] == entity) return (uint32_t)i;
+      return NativeScriptComponent::NullSlot;
+    }
+
+  protected:
+    std::vector<entt::entity> m_Entities; // per slot, null once destroyed
+    size_t m_Started = 0;                 // slots below have had OnCreate
+    size_t m_Dead = 0;
+  };
+
+  template<typename T>
+  class ScriptPool final : public ScriptPoolBase {
+    static_assert(std::is_base_of_v<ScriptableEntity, T>, "scripts derive from ScriptableEntity");
+
+    // hooks T leaves to ScriptableEntity cost no loop at all
+    static constexpr bool HasCreate = !std::is_same_v<decltype(&T::OnCreate), decltype(&ScriptableEntity::OnCreate)>;
+    static constexpr bool HasUpdate = !std::is_same_v<decltype(&T::OnUpdate), decltype(&ScriptableEntity::OnUpdate)>;
+    static constexpr bool HasDestroy = !std::is_same_v<decltype(&T::OnDestroy), decltype(&ScriptableEntity::OnDestroy)>;
+
+  public:
+    uint32_t Add(Entity entity) override {
+      T& script = m_Scripts.emplace_back();
+      static_cast<ScriptableEntity&>(script).m_Entity = entity;
+      m_Entities.push_back(entity);
+      return (uint32_t)m_Scripts.size() - 1;
+    }
+
+    void Start() override {
+      // OnCreate may bind scripts elsewhere; the Scene adds those after this
+      while (m_Started < m_Scripts.size()) {
+	const size_t i = m_Started++;
+	if constexpr (HasCreate)
+	  if (m_Entities[i] != entt::null) m_Scripts[i].OnCreate();
+      }
+    }
+
+    void Update(float dt) override {
+      if constexpr (HasUpdate) {
+	T* scripts = m_Scripts.data();
+	const entt::entity* entities = m_Entities.data();
+	const size_t count = m_Scripts.size();
+	for (size_t i = 0; i < count; ++i)
+	  if (entities[i] != entt::null) scripts[i].OnUpdate(dt);
+      }
+    }
+
+    void Destroy(uint32_t slot) override {
+      if (slot >= m_Scripts.size() || m_Entities[slot] == entt::null) return;
+      // marked first: OnDestroy may destroy more entities
+      m_Entities[slot] = entt::null;
+      ++m_Dead;
+      if constexpr (HasDestroy)
+	if (slot < m_Started) m_Scripts[slot].OnDestroy();
+    }
+
+    void Compact(entt::registry& registry) override {
+      if (m_Dead == 0) return;
+      size_t out = 0;
+      for (size_t i = 0; i < m_Scripts.size(); ++i) {
+	if (m_Entities[i] == entt::null) continue;
+	if (out != i) {
+	  m_Scripts[out] = std::move(m_Scripts[i]);
+	  m_Entities[out] = m_Entities[i];
+	  registry.get<NativeScriptComponent>(m_Entities[i]).slot = (uint32_t)out;
+	}
+	++out;
+      }
+      m_Scripts.erase(m_Scripts.begin() + out, m_Scripts.end());
+      m_Entities.resize(out);
+      m_Started = out;
+      m_Dead = 0;
+    }
+
+    void Clear() override {
+      for (uint32_t slot = 0; slot < m_Scripts.size(); ++slot)
+	Destroy(slot);
+      m_Scripts.clear();
+      m_Entities.clear();
+      m_Started = m_Dead = 0;
+    }
+
+    ScriptableEntity* Get(uint32_t slot) override {
+      return slot < m_Scripts.size() && m_Entities[slot] != entt::null ? &m_Scripts[slot] : nullptr;
+    }
+
+  private:
+    std::vector<T> m_Scripts;
+  };
+
+  template<typename T>
+  Scope<ScriptPoolBase> CreateScriptPool() {
+    return CreateScope<ScriptPool<T>>();
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Core/StringID.h"
+#include "Scene/Components.h"
+#include <entt/entt.hpp>
+
+namespace RE {
+
+  // Component template set for Scene::Instantiate. Every instance gets a fresh
+  // UUID, the prefab's name and a transform (its own or the template's); every
+  // other component is copied from the value stored here, one pool insert per type.
+  class Prefab {
+  public:
+    explicit Prefab(std::string_view name = "Entity")
+      : m_Name(StringInterner::Intern(name)) {}
+
+    // set or overwrite the template value of T
+    template<typename T, typename... Args>
+    T& Add(Args&&... args) {
+      static_assert(!std::is_same_v<T, IDComponent> && !std::is_same_v<T, TagComponent>,
+		    "instances get their id and name from Scene::Instantiate");
+      if constexpr (std::is_same_v<T, TransformComponent>) {
+	m_Transform = MakeComponent<T>(std::forward<Args>(args)...);
+	return m_Transform;
+      } else {
+	Component<T>* component = Find<T>();
+	if (!component) {
+	  auto created = CreateScope<Component<T>>();
+	  created->type = entt::type_hash<T>::value();
+	  component = created.get();
+	  m_Components.push_back(std::move(created));
+	}
+	component->value = MakeComponent<T>(std::forward<Args>(args)...);
+	return component->value;
+      }
+    }
+
+    template<typename T>
+    T* TryGet() {
+      Component<T>* component = Find<T>();
+      return component ? &component->value : nullptr;
+    }
+
+    template<typename T>
+    const T* TryGet() const { return const_cast<Prefab*>(this)->TryGet<T>(); }
+
+    template<typename T>
+    void Remove() {
+      const auto type = entt::type_hash<T>::value();
+      m_Components.erase(std::remove_if(m_Components.begin(), m_Components.end(),
+					[type](const auto& component) { return component->type == type; }),
+			 m_Components.end());
+    }
+
+    StringID GetName() const { return m_Name; }
+    void SetName(std::string_view name) { m_Name = StringInterner::Intern(name); }
+    const TransformComponent& GetTransform() const { return m_Transform; }
+
+  private:
+    struct ComponentBase {
+      entt::id_type type = 0;
+      virtual ~ComponentBase() = default;
+      virtual void Insert(entt::registry& registry, const entt::entity* first, const entt::entity* last) const = 0;
+    };
+
+    template<typename T>
+    struct Component : ComponentBase {
+      T value{};
+
+      void Insert(entt::registry& registry, const entt::entity* first, const entt::entity* last) const override {
+	registry.insert<T>(first, last, value);
+      }
+    };
+
+    template<typename T, typename... Args>
+    static T MakeComponent(Args&&... args) {
+      if constexpr (std::is_constructible_v<T, Args...>)
+	return T(std::forward<Args>(args)...);
+      else
+	return T{ std::forward<Args>(args)... };
+    }
+
+    template<typename T>
+    Component<T>* Find() {
+      const auto type = entt::type_hash<T>::value();
+      for (auto& component : m_Components)
+	if (component->type == type)
+	  return static_cast<Component<T>*>(component.get());
+      return nullptr;
+    }
+
+  private:
+    StringID m_Name;
+    TransformComponent m_Transform;
+    std::vector<Scope<ComponentBase>> m_Components;
+    friend class Scene;
+  };
+}
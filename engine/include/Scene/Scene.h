@@ -2,11 +2,39 @@
 
 #include "Core/UUID.h"
 #include "Auxiliaries/Physics.h"
+#include "Core/ThreadPool.h"
+#include "Core/UUIDMap.h"
+#include "Core/StringID.h"
+#include "Scene/DynamicBVH.h"
+#include "Scene/ChangeTracker.h"
+#include "Scene/TransformPool.h"
+#include "Scene/SystemScheduler.h"
+#include "Scene/InstanceRenderer.h"
+#include "Scene/StaticGeometry.h"
 #include <entt/entt.hpp>
 
 namespace RE {
 
 class Entity;
+class CommandBuffer;
+class Prefab;
+class WorldPartition;
+struct Shape;
+class ScriptableEntity;
+class ScriptPoolBase;
+struct NativeScriptComponent;
+struct RigidbodyComponent;
+struct TransformComponent;
+
+// one registry pool as seen by Scene::GetStorageReport
+struct StoragePoolStats {
+    std::string_view name;
+    size_t count = 0;
+    size_t capacity = 0;        // slots allocated
+    size_t bytes = 0;           // packed, components and sparse array
+    size_t unusedBytes = 0;     // allocated without an element in it
+    float fragmentation = 0.0f; // unusedBytes / bytes
+};
 
 enum class SceneState {
     Edit = 0,
@@ -18,43 +46,300 @@ enum class SceneState {
     Scene();
     ~Scene();
 
-    Entity CreateEntity(const std::string &name = std::string());
+    // Clone every entity and component pool (same entity ids). Play runs on the
+    // copy and Stop just drops it. The world partition is cloned onto the copy.
+    // Physics handles, command buffers and native script instances are not
+    // carried over.
+    static Ref<Scene> Copy(const Ref<Scene>& other);
+
+    Entity CreateEntity(std::string_view name = std::string_view());
     Entity CreateEntityWithUUID(UUID uuid,
-				const std::string& name = std::string());
+				std::string_view name = std::string_view());
+
+    // `count` copies of a prefab in one range create plus one insert per pool.
+    // transforms (count of them) override the prefab's; while physics runs the
+    // rigidbodies are added in bulk around one shared shape.
+    std::vector<entt::entity> Instantiate(const Prefab& prefab, size_t count,
+					  const TransformComponent* transforms = nullptr);
+
+    // entity carrying this IDComponent, or an invalid Entity. Replaced and
+    // patched IDComponents are re-keyed; in-place writes of ID are not seen.
+    Entity GetEntityByUUID(UUID uuid);
+    // bulk lookup for loaders and networking; entt::null for unknown ids
+    void ResolveUUIDs(const uint64_t* uuids, size_t count, entt::entity* out) const;
+
+    // some entity tagged `name`, or an invalid Entity. Names need not be unique.
+    Entity FindByName(std::string_view name);
+    Entity FindByName(StringID name);
+    // renames, tag replaces and patches keep the name index exact; writing
+    // TagComponent::Tag through a plain reference does not
+    void SetEntityName(entt::entity entity, std::string_view name);
 
     void DestroyEntity(Entity entity);
     void DestroyEntityNow(Entity entity);
     void FlushEntityDestruction();
 
+    // Per-thread command buffer for deferred create/destroy/component changes; safe
+    // to call from workers. Fetch once per job rather than per command.
+    CommandBuffer& GetCommandBuffer();
+    // plays back every thread's buffer; main thread only, runs at frame end
+    void FlushCommandBuffers();
+
+    // Systems run by OnUpdateRuntime after streaming and before physics; those
+    // with disjoint component access run concurrently. Copy keeps them.
+    SystemScheduler& GetSystems() { return m_Systems; }
+    const SystemScheduler& GetSystems() const { return m_Systems; }
+    // scene tick groups, ticked by OnUpdateRuntime right after the systems;
+    // Copy does not carry them, their callbacks tend to capture this scene
+    TickScheduler& GetTicks() { return m_Ticks; }
+
     void OnRuntimeStart();
     void OnRuntimeStop();
+    // between OnRuntimeStart and OnRuntimeStop; physics may be paused meanwhile
+    bool IsRunning() const { return m_Running; }
+
+    // the running script bound to `entity`, nullptr if it has none of type T
+    template<typename T>
+    T* GetScript(entt::entity entity){
+      return static_cast<T*>(GetScript(entity, entt::type_hash<T>::value()));
+    }
+    ScriptableEntity* GetScript(entt::entity entity, entt::id_type type);
     void PhysicsUpdate(float dt);
 
+    // scene-wide layer collision matrix lives on the physics world
+    Physics3D& GetPhysics3D() { return m_Physics3D; }
+    void SetLayerCollision(CollisionLayer a, CollisionLayer b, bool collide) {
+      m_Physics3D.SetLayerCollision(a, b, collide);
+    }
+
+    // optional cell streaming around the primary camera, updated every frame
+    void SetWorldPartition(const Ref<WorldPartition>& partition) { m_WorldPartition = partition; }
+    const Ref<WorldPartition>& GetWorldPartition() const { return m_WorldPartition; }
+
+    // SoA copy of every transform with its world matrix, rebuilt each update
+    // before the spatial index refit; drawing and picking read matrices from it
+    const TransformPool& GetTransforms() const { return m_Transforms; }
+
+    // visible models are drawn instanced, grouped by asset; draw call and
+    // instance counts of the last frame
+    const InstanceRenderer& GetInstances() const { return m_Instances; }
+
+    // Merges the models of static entities (StaticComponent, or a static
+    // rigidbody) into per-material meshes clustered on a cellSize grid and
+    // stops drawing them one by one. OnRuntimeStart bakes, OnRuntimeStop
+    // clears. Baked entities are expected to stay where they are; one that
+    // loses its model or StaticComponent (or is destroyed) leaves the merged
+    // meshes, and its clusters are merged again at the next draw.
+    void BakeStaticGeometry(float cellSize = 32.0f);
+    void ClearStaticGeometry() { m_StaticGeometry.Clear(); }
+    const StaticGeometry& GetStaticGeometry() const { return m_StaticGeometry; }
+
+    // Dynamic BVH over drawable entities (cube, sphere, plane, model), refit at the
+    // start of every update; drawing is culled through it. The refit recomputes
+    // every drawable's bounds, O(n) a frame, unless TransformComponent is tracked
+    // (TrackChanges): then only the entities in its change sets are revisited, so
+    // in-place transform writes must be reported with MarkChanged.
+    const DynamicBVH& GetSpatialIndex() const { return m_SpatialIndex; }
+    // nearest drawable entity the ray hits, or an invalid Entity. Models are hit
+    // on their triangles (ModelAsset::BVH), everything else on its bounds.
+    Entity Raycast(const Ray& ray, float maxDistance = FLT_MAX, float* distance = nullptr);
+    // entity under a screen position, seen through the camera the scene draws with
+    Entity Pick(Vector2 screenPosition);
+
+    // Storage maintenance for loading screens. Sorts the hot pools by a Morton
+    // code of position (models by asset first), brings the related pools into
+    // the same order and shrinks every pool. OptimizeStep runs one stage per
+    // call and returns true once the pass is complete, to spread it over
+    // frames. Main thread, between updates.
+    void Optimize();
+    bool OptimizeStep();
+    std::vector<StoragePoolStats> GetStorageReport() const;
+
+    // Opt-in change tracking per component type. Once tracked, GetChanges<T>()
+    // lists the entities whose T was added, replaced/patched or removed during
+    // the last frame. Writes through a plain reference are not seen: use
+    // Entity::PatchComponent or MarkChanged. Copy keeps the tracked types.
+    template<typename T>
+    const ChangeSet& TrackChanges(){
+      auto& tracker = m_ChangeTrackers[entt::type_hash<T>::value()];
+      if (!tracker) {
+	tracker = CreateScope<ChangeTracker>(&ChangeTracker::Connect<T>);
+	ChangeTracker::Connect<T>(m_Registry, *tracker);
+      }
+      return tracker->GetChanges();
+    }
+
+    template<typename T>
+    void UntrackChanges(){
+      auto it = m_ChangeTrackers.find(entt::type_hash<T>::value());
+      if (it == m_ChangeTrackers.end()) return;
+      ChangeTracker::Disconnect<T>(m_Registry, *it->second);
+      m_ChangeTrackers.erase(it);
+    }
+
+    // last frame's changes of T, nullptr while T is untracked
+    template<typename T>
+    const ChangeSet* GetChanges() const{
+      const ChangeTracker* tracker = FindTracker<T>();
+      return tracker ? &tracker->GetChanges() : nullptr;
+    }
+
+    // reports an in-place write; free when T is untracked. Main thread only.
+    template<typename T>
+    void MarkChanged(entt::entity entity){
+      if (ChangeTracker* tracker = FindTracker<T>())
+	tracker->Mark(entity, Changes::Updated);
+    }
+
     void OnUpdate(float dt);
     void OnUpdateRuntime(float dt);
     Vector3 testPos = {0};
 
-    template<typename Entt, typename Comp, typename Task>
+    // task(Entt, Comp&...) for every entity owning all of Comp; empty (tag)
+    // components are matched but not passed
+    template<typename Entt, typename... Comp, typename Task>
     void ViewEntity(Task&& task){
       // E_CORE_ASSERT(std::is_base_of<Entity, Entt>::value, "error viewing entt");
-      m_Registry.view<Comp>().each([this, &task] 
-				   (const auto entity, auto& comp) 
+      m_Registry.view<Comp...>().each([this, &task] 
+				   (const auto entity, auto&... comps) 
       { 
 	// task(std::move(Entt(&m_Registry, entity)), comp);
-	task(std::move(Entt(entity, this)), comp);
+	task(std::move(Entt(entity, this)), comps...);
       });
     }
+
+    // like ViewEntity without the Entity wrapper: task(entt::entity, Comp&...) or
+    // task(Comp&...), straight from the pools
+    template<typename... Comp, typename Task>
+    void Each(Task&& task){
+      m_Registry.view<Comp...>().each(std::forward<Task>(task));
+    }
+
+    // Each split over the ThreadPool in batches of the view's leading pool.
+    // task(entt::entity, Comp&...) may only touch the components it is handed:
+    // no entity creation/destruction and no component add/remove.
+    template<typename... Comp, typename Task>
+    void ParallelEach(Task&& task, size_t minBatch = 256){
+      auto view = m_Registry.view<Comp...>();
+      const auto* leading = view.handle();
+      if (!leading) return;
+
+      ThreadPool::Get().ParallelFor(leading->size(), minBatch, [&view, leading, &task](size_t begin, size_t end) {
+	for (size_t i = begin; i < end; ++i) {
+	  const entt::entity entity = (*leading)[i];
+	  if (!view.contains(entity)) continue;
+	  std::apply(task, std::tuple_cat(std::make_tuple(entity), view.get(entity)));
+	}
+      });
+    }
+    // ParallelEach over an entt group. Group members occupy [0, size) of the
+    // group's leading pool, so batches walk the packed arrays in order.
+    template<typename Group, typename Task>
+    void ParallelEachIn(Group group, Task&& task, size_t minBatch = 256){
+      const entt::entity* entities = group.handle().data();
+      ThreadPool::Get().ParallelFor(group.size(), minBatch, [&group, entities, &task](size_t begin, size_t end) {
+	for (size_t i = begin; i < end; ++i) {
+	  const entt::entity entity = entities[i];
+	  std::apply(task, std::tuple_cat(std::make_tuple(entity), group.get(entity)));
+	}
+      });
+    }
+
   private:
+    explicit Scene(bool setupRegistry);
+    void SetupRegistry();
+    void OnIDConstruct(entt::registry& registry, entt::entity entity);
+    void OnIDUpdate(entt::registry& registry, entt::entity entity);
+    void OnIDDestroy(entt::registry& registry, entt::entity entity);
+    void OnTagConstruct(entt::registry& registry, entt::entity entity);
+    void OnTagUpdate(entt::registry& registry, entt::entity entity);
+    void OnTagDestroy(entt::registry& registry, entt::entity entity);
+    void IndexName(StringID name, entt::entity entity);
+    void UnindexName(StringID name, entt::entity entity);
+    void OnDrawableChanged(entt::registry& registry, entt::entity entity);
+    void OnRigidbodyDestroy(entt::registry& registry, entt::entity entity);
+    void OnTriggerDestroy(entt::registry& registry, entt::entity entity);
+    void OnTerrainDestroy(entt::registry& registry, entt::entity entity);
+    void OnStaticChanged(entt::registry& registry, entt::entity entity);
+    void OnScriptConstruct(entt::registry& registry, entt::entity entity);
+    void OnScriptReplace(entt::registry& registry, entt::entity entity);
+    void OnScriptDestroy(entt::registry& registry, entt::entity entity);
+    ScriptPoolBase* FindScriptPool(entt::id_type type) const;
+    void CreatePendingScripts();
+    void UpdateScripts(float dt);
+    void StopScripts();
+    void FlushReleases();
+    uint64_t OptimizeKey(entt::entity entity) const;
+    void NextChangeFrame();
+
+    template<typename T>
+    ChangeTracker* FindTracker() const{
+      if (m_ChangeTrackers.empty()) return nullptr;
+      auto it = m_ChangeTrackers.find(entt::type_hash<T>::value());
+      return it != m_ChangeTrackers.end() ? it->second.get() : nullptr;
+    }
+    void UpdateSpatialIndex();
+    void DrawVisible(const Camera3D& camera);
+
     template <typename T> void OnComponentAdded(Entity entity, T &component);
+    btCollisionShape* BuildShape(Shape& shape);
+    void CreateRigidBody(entt::entity entity, RigidbodyComponent& comp, TransformComponent& transform);
+    void CreateRigidBodies(const entt::entity* entities, size_t count);
+    void CreateTriggers(const entt::entity* entities, size_t count);
+    void UpdateStreaming(const Camera3D* camera);
+    void DispatchTriggerEvents();
 
   private:
+    // how many entities carry a name, and one of them (null once it goes away)
+    struct NameEntry {
+      entt::entity entity = entt::null;
+      uint32_t count = 0;
+    };
+
+    // declared before the registry so they outlive any destroy signals
+    UUIDMap<entt::entity> m_EntityIndex{ entt::entity(entt::null) };
+    UUIDMap<NameEntry> m_NameIndex;
+    std::vector<StringID> m_IndexedNames; // name each entity is indexed under, by entity index
+    std::vector<uint64_t> m_IndexedIDs;   // likewise for the UUID index
+    // physics handles of destroyed components, freed together by FlushReleases
+    std::vector<void*> m_BodyReleases;
+    std::vector<void*> m_TriggerReleases;
+    std::unordered_map<entt::id_type, Scope<ChangeTracker>> m_ChangeTrackers;
+    // running native scripts, one pool per script type in first-bound order
+    std::vector<Scope<ScriptPoolBase>> m_ScriptPools;
+    std::unordered_map<entt::id_type, uint32_t> m_ScriptPoolIndex;
+    std::vector<entt::entity> m_ScriptCreates; // bound while running, created by UpdateScripts
+    std::vector<entt::entity> m_ScriptBatch;
+    bool m_ScriptsRunning = false;
     entt::registry m_Registry;
     std::vector<entt::entity> m_DestroyQueue;
+    TransformPool m_Transforms;
+    DynamicBVH m_SpatialIndex;
+    std::vector<entt::entity> m_SpatialPending;  // gained or lost a drawable since the last refit
+    std::vector<entt::entity> m_SpatialRefit;    // moved drawables, with transforms tracked
+    std::vector<BoundingBox> m_SpatialBounds;    // refit scratch
+    std::vector<uint8_t> m_SpatialMoved;
+    std::vector<entt::entity> m_Visible;
+    InstanceRenderer m_Instances;
+    StaticGeometry m_StaticGeometry;
+    uint32_t m_OptimizeStage = 0;
+    std::vector<uint64_t> m_OptimizeKeys; // Morton code per entity index
+    std::vector<Scope<CommandBuffer>> m_CommandBuffers;
+    std::unordered_map<std::thread::id, size_t> m_CommandBufferIndex;
+    std::mutex m_CommandMutex;
+    Ref<WorldPartition> m_WorldPartition;
+    SystemScheduler m_Systems;
+    TickScheduler m_Ticks;
     Physics3D m_Physics3D;
     Camera3D m_EditorCam;
     Camera3D *m_RuntimeCam = nullptr;
     void* boxBody;
     bool inView = false;
+    bool m_Running = false;
     friend class Entity;
+    friend class CommandBuffer;
+    friend class SceneSerializer;
+    friend class SceneLoader;
+    friend class WorldPartition;
   };
 }
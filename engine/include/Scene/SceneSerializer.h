@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Auxiliaries/Assets.h"
+#include <entt/entt.hpp>
+#include <string>
+#include <vector>
+
+namespace RE {
+
+  class Scene;
+  class MappedFile;
+
+  // Binary scene file (.rscn). Every component type is stored as one contiguous
+  // array plus the file-local index of each owner, so loading is a range create
+  // and one bulk insert per pool straight out of a memory-mapped file. Tags live
+  // in a string table; models and skyboxes are stored as AssetIDs and resolved
+  // against the AssetRegistry on load.
+  //
+  // Saved: ID, Tag, Transform, Cube, Sphere, Plane, Camera3D, Model, Skybox and
+  // rigidbodies with a box, sphere or plane shape. Compound bodies, triggers,
+  // terrain and animation are rebuilt by code for now.
+  class SceneSerializer {
+  public:
+    SceneSerializer(Scene* scene, AssetRegistry* assets = nullptr)
+      : m_Scene(scene), m_Assets(assets) {}
+
+    bool SerializeBinary(const std::string& path);
+    // only the given entities, in that order
+    bool SerializeBinary(const std::string& path, const std::vector<entt::entity>& entities);
+
+    // appends the file's entities to the scene; needs the AssetRegistry for models
+    bool DeserializeBinary(const std::string& path);
+    bool DeserializeBinary(const SceneAsset& asset) { return DeserializeBinary(asset.Source); }
+
+  private:
+    Scene* m_Scene = nullptr;
+    AssetRegistry* m_Assets = nullptr;
+  };
+
+  // Loads one .rscn in slices. Open() maps, validates and pages in the file without
+  // touching any scene, so it may run on a worker thread; Integrate() inserts into
+  // the registry and belongs on the main thread.
+  class SceneLoader {
+  public:
+    SceneLoader();
+    ~SceneLoader();
+
+    SceneLoader(const SceneLoader&) = delete;
+    SceneLoader& operator=(const SceneLoader&) = delete;
+
+    bool Open(const std::string& path);
+
+    // create up to `budget` more entities with all their components; returns how
+    // many were created and appends them to `created` when given
+    size_t Integrate(Scene& scene, AssetRegistry* assets, size_t budget,
+		     std::vector<entt::entity>* created = nullptr);
+
+    bool Done() const { return m_Next >= m_EntityCount; }
+    uint32_t GetEntityCount() const { return m_EntityCount; }
+    const std::string& GetPath() const { return m_Path; }
+
+  private:
+    Scope<MappedFile> m_File;
+    std::string m_Path;
+    uint32_t m_EntityCount = 0;
+    uint32_t m_SectionCount = 0;
+    std::vector<uint32_t> m_Cursors; // next record per section
+    uint32_t m_Next = 0;             // next file entity
+  };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "raylib.h"
+#include <entt/entt.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Frustum;
+
+namespace RE {
+
+  class TransformPool;
+  struct ModelAsset;
+
+  // Static scenery merged into a few world-space meshes. Bake buckets the
+  // meshes of static models by grid cell and material and merges each bucket
+  // into meshes of at most 65535 vertices, each with bounds for culling; the
+  // entity tint goes into the vertex colors. Baked entities keep their
+  // components (physics, picking) but are not drawn one by one any more.
+  // Remove takes an entity out again (the Scene calls it when the model or
+  // the static flag goes away); its clusters are merged anew by the next Draw.
+  //
+  // Models with a custom shader, bones or an AnimationComponent are left out.
+  class StaticGeometry {
+  public:
+    StaticGeometry() = default;
+    StaticGeometry(const StaticGeometry&) = delete;
+    StaticGeometry& operator=(const StaticGeometry&) = delete;
+    ~StaticGeometry() { Clear(); }
+
+    void Bake(const entt::registry& registry, const TransformPool& transforms, float cellSize);
+    // frees the merged meshes; main thread with the GL context alive
+    void Clear();
+
+    bool IsBaked(entt::entity entity) const {
+      const size_t index = entt::to_entity(entity);
+      return index < m_Baked.size() && m_Baked[index].entity == entity;
+    }
+
+    // drops the entity's pieces and marks its clusters for merging again
+    void Remove(entt::entity entity);
+
+    // merges dirty clusters first; main thread
+    void Draw(const Frustum& frustum);
+
+    size_t GetBatchCount() const { return m_BatchCount; }
+    size_t GetBakedCount() const { return m_BakedCount; }
+    uint32_t GetDrawCalls() const { return m_DrawCalls; } // last Draw
+
+  private:
+    struct Batch {
+      Mesh mesh{};
+      BoundingBox bounds{};
+    };
+
+    struct Piece {
+      const Mesh* mesh;
+      Matrix transform;
+      Color tint;
+      entt::entity entity;
+    };
+
+    // one grid cell and material
+    struct Cluster {
+      Material material{};
+      std::vector<Piece> pieces;
+      std::vector<Batch> batches;
+      bool dirty = false;
+    };
+
+    struct Baked {
+      entt::entity entity = entt::null;
+      uint32_t firstCluster = 0, lastCluster = 0; // clusters of its cell
+    };
+
+    static Mesh MergeMesh(const Piece* pieces, size_t count, int vertexCount, int indexCount, BoundingBox& bounds);
+    void Merge(Cluster& cluster);
+    void Unload(Cluster& cluster);
+
+  private:
+    std::vector<Cluster> m_Clusters;
+    std::vector<Ref<ModelAsset>> m_Assets; // keep the pieces' meshes alive
+    std::vector<Baked> m_Baked;            // by entity index
+    size_t m_BakedCount = 0;
+    size_t m_BatchCount = 0;
+    bool m_Dirty = false;
+    uint32_t m_DrawCalls = 0;
+  };
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Core/StringID.h"
+#include "Core/TickScheduler.h"
+#include <entt/entt.hpp>
+#include <functional>
+#include <vector>
+
+namespace RE {
+
+  class Scene;
+
+  // What a system touches. Two systems conflict when one writes a component
+  // the other reads or writes; conflicting systems run in registration order,
+  // everything else may run at the same time on the ThreadPool.
+  class SystemAccess {
+  public:
+    template<typename... T>
+    SystemAccess& Read() { (Add<T>(m_Reads), ...); return *this; }
+
+    template<typename... T>
+    SystemAccess& Write() { (Add<T>(m_Writes), ...); return *this; }
+
+    // raylib calls (drawing, input) are only safe on the main thread
+    SystemAccess& MainThread() { m_MainThread = true; return *this; }
+    // conflicts with every other system, e.g. for entity creation outside a CommandBuffer
+    SystemAccess& Exclusive() { m_Exclusive = true; return *this; }
+
+    bool Conflicts(const SystemAccess& other) const;
+
+  private:
+    template<typename T>
+    void Add(std::vector<entt::id_type>& types) {
+      const entt::id_type type = entt::type_hash<T>::value();
+      auto it = std::lower_bound(types.begin(), types.end(), type);
+      if (it != types.end() && *it == type) return;
+      types.insert(it, type);
+      // pools are created before systems start, never while they run
+      m_Pools.push_back([](entt::registry& registry) { registry.storage<T>(); });
+    }
+
+  private:
+    std::vector<entt::id_type> m_Reads;   // sorted
+    std::vector<entt::id_type> m_Writes;  // sorted
+    std::vector<void (*)(entt::registry&)> m_Pools;
+    bool m_MainThread = false;
+    bool m_Exclusive = false;
+    friend class SystemScheduler;
+  };
+
+  struct SystemTiming {
+    StringID name = 0;
+    float startMs = 0.0f; // since the scheduler started the frame
+    float ms = 0.0f;
+    bool mainThread = false;
+  };
+
+  // Runs a scene's systems, every frame or at a rate set with SetRate. Every
+  // frame the enabled systems that are due are ordered into a DAG from their
+  // declared access: a system waits for each earlier registered system it
+  // conflicts with. Ready systems go to the ThreadPool; the calling thread
+  // takes work too and runs the MainThread ones.
+  //
+  // A system may only touch the components it declared. Structural changes
+  // (create, destroy, add, remove) go through Scene::GetCommandBuffer().
+  class SystemScheduler {
+  public:
+    using SystemFn = std::function<void(Scene&, float)>;
+    using SystemID = uint32_t;
+
+    SystemID Add(std::string_view name, const SystemAccess& access, SystemFn fn);
+    void Remove(SystemID id);
+    void SetEnabled(SystemID id, bool enabled);
+    // run at `rateHz` (0: every frame) instead, at `phase` of the period
+    // (negative spreads systems of one rate across frames); the system is
+    // handed the time since its last run
+    void SetRate(SystemID id, float rateHz, float phase = -1.0f);
+    size_t Size() const { return m_Systems.size(); }
+
+    void Run(Scene& scene, entt::registry& registry, float dt);
+
+    // one entry per system run by the last Run, in registration order
+    const std::vector<SystemTiming>& GetTimings() const { return m_Timings; }
+    float GetFrameMs() const { return m_FrameMs; }
+
+  private:
+    struct System {
+      SystemID id = 0;
+      StringID name = 0;
+      SystemAccess access;
+      SystemFn fn;
+      bool enabled = true;
+      double period = 0.0;
+      TickClock clock;
+    };
+
+    System* Find(SystemID id);
+
+  private:
+    std::vector<System> m_Systems;
+    SystemID m_NextID = 1;
+    double m_Time = 0.0;
+    uint32_t m_Spread = 0;
+
+    // per-frame DAG over the systems that run, indexed like m_Timings
+    std::vector<uint32_t> m_Frame;        // index into m_Systems
+    std::vector<float> m_FrameDt;
+    std::vector<uint32_t> m_Waits;        // unfinished predecessors
+    std::vector<std::vector<uint32_t>> m_Successors;
+    std::vector<SystemTiming> m_Timings;
+    float m_FrameMs = 0.0f;
+  };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Core/Config.h"
+#include <entt/entt.hpp>
+#include <vector>
+
+namespace RE {
+
+  // Structure-of-arrays mirror of the TransformComponent pool, rebuilt once a
+  // frame. Positions, rotation quaternions and scales sit in separate lanes and
+  // every world matrix is built from them in one SIMD pass (8 wide with AVX2,
+  // 4 with SSE2). Entries follow the pool's packed order.
+  //
+  // Matrices match DrawModelEx(position, Rotation as axis, 1 degree, scale); a
+  // zero axis is the identity rotation.
+  class TransformPool {
+  public:
+    struct Lanes {
+      std::vector<float> x, y, z;
+      std::vector<float> qx, qy, qz, qw;
+      std::vector<float> sx, sy, sz;
+    };
+
+    // copy every transform out of the registry and rebuild the matrices
+    void Update(const entt::registry& registry);
+
+    size_t Size() const { return m_Entities.size(); }
+    const std::vector<entt::entity>& GetEntities() const { return m_Entities; }
+    const Lanes& GetLanes() const { return m_Lanes; }
+    const std::vector<Matrix>& GetMatrices() const { return m_World; }
+
+    // world matrix of `entity` from the last Update, or nullptr if it had no
+    // transform then
+    const Matrix* Find(entt::entity entity) const {
+      const size_t index = entt::to_entity(entity);
+      if (index >= m_IndexOf.size()) return nullptr;
+      const uint32_t slot = m_IndexOf[index];
+      return slot < m_Entities.size() && m_Entities[slot] == entity ? &m_World[slot] : nullptr;
+    }
+
+    // world matrices for [begin, end) of the lanes; normalizes the axes held in
+    // qx, qy, qz into quaternions on the way
+    static void BuildMatrices(Lanes& lanes, size_t begin, size_t end, Matrix* out);
+
+  private:
+    std::vector<entt::entity> m_Entities;
+    Lanes m_Lanes;
+    std::vector<Matrix> m_World;
+    std::vector<uint32_t> m_IndexOf; // slot by entity index
+  };
+}
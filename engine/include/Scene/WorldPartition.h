@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Core/Config.h"
+#include "Auxiliaries/Assets.h"
+#include <entt/entt.hpp>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace RE {
+
+  class Scene;
+  class SceneLoader;
+
+  struct WorldPartitionSettings {
+    float loadRadius = 192.0f;   // cells whose XZ footprint is closer than this stream in
+    float unloadRadius = 256.0f; // and stream out again beyond this (keep above loadRadius)
+    int entityBudget = 4096;     // entities created or destroyed per frame
+    int bodyBudget = 256;        // physics bodies added per frame while playing
+    int maxLoadsInFlight = 4;    // cell files being read on worker threads
+  };
+
+  struct WorldPartitionStats {
+    int cells = 0;
+    int loading = 0;
+    int integrating = 0;
+    int loaded = 0;
+    size_t residentEntities = 0;
+    size_t pendingDestroys = 0;
+    size_t pendingBodies = 0;
+  };
+
+  // Splits a world into square XZ cells, one .rscn file each, and streams them in
+  // and out around a focus point. Files are opened and paged in on the ThreadPool;
+  // entities and physics bodies are then added under a per-frame budget so the
+  // cost of a frame does not depend on how big the world is.
+  class WorldPartition {
+  public:
+    WorldPartition(Scene* scene, AssetRegistry* assets = nullptr);
+    ~WorldPartition();
+
+    WorldPartition(const WorldPartition&) = delete;
+    WorldPartition& operator=(const WorldPartition&) = delete;
+
+    // Write every entity of `scene` into the cell under its translation, plus an
+    // index, into `directory`. Cameras, skyboxes and terrain are global and skipped.
+    static bool Bake(Scene& scene, const std::string& directory, float cellSize);
+
+    bool Open(const std::string& directory, const WorldPartitionSettings& settings = {});
+    // The same partition streaming into `scene`, a Scene::Copy of this one's
+    // scene (same entity ids). Loaded cells keep their entity lists. Cells still
+    // being read start over in the clone. Partly integrated cells are removed
+    // from `scene` and loaded again whole. This partition is left as it was.
+    Ref<WorldPartition> Clone(Scene* scene) const;
+    // destroys every streamed entity right away; the destructor leaves them in the scene
+    void Close();
+
+    // stream around `focus`; Scene calls this every frame with the primary camera
+    void Update(const Vector3& focus);
+
+    float GetCellSize() const { return m_CellSize; }
+    WorldPartitionSettings& GetSettings() { return m_Settings; }
+    const WorldPartitionStats& GetStats() const { return m_Stats; }
+
+  private:
+    enum class CellState : uint8_t { Unloaded, Loading, Integrating, Loaded };
+
+    struct PendingLoad {
+      Scope<SceneLoader> loader;
+      std::atomic<bool> ready{ false };
+      bool ok = false;
+    };
+
+    struct Cell {
+      int x = 0, z = 0;
+      CellState state = CellState::Unloaded;
+      Ref<PendingLoad> load;
+      std::vector<entt::entity> entities;
+    };
+
+    static uint64_t CellKey(int x, int z) {
+      return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+    }
+    std::string CellPath(int x, int z) const;
+    float CellDistance(const Cell& cell, const Vector3& focus) const;
+
+    void StartLoads(const Vector3& focus);
+    void Integrate(const Vector3& focus);
+    void UnloadFar(const Vector3& focus);
+    void Unload(Cell& cell);
+    void FlushDestroys();
+    void FlushBodies();
+
+  private:
+    Scene* m_Scene = nullptr;
+    AssetRegistry* m_Assets = nullptr;
+    std::string m_Directory;
+    float m_CellSize = 0.0f;
+    WorldPartitionSettings m_Settings;
+
+    std::unordered_map<uint64_t, Cell> m_Cells;
+    std::vector<uint64_t> m_Resident;          // cells not Unloaded
+    std::vector<entt::entity> m_DestroyQueue;  // entities of cells that went out of range
+    std::vector<entt::entity> m_BodyQueue;     // streamed rigidbodies waiting for a body
+    int m_LoadsInFlight = 0;
+    std::vector<Ref<PendingLoad>> m_AbandonedLoads; // unloaded while still reading
+    WorldPartitionStats m_Stats;
+  };
+}
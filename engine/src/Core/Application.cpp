@@ -51,6 +51,7 @@ namespace RE {
 
       BeginDrawing();
       if(!m_Minimized){
+	m_Ticks.Tick(deltaTime);
 	for(Layer* layer : m_LayerStack){
 	  layer->OnUpdate(deltaTime);
 	}
@@ -0,0 +1,335 @@
+#include "repch.h"
+#include "Auxiliaries/MeshBVH.h"
+#include "Core/ThreadPool.h"
+#include "raymath.h"
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RE_MESHBVH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace RE {
+
+  namespace {
+    constexpr int BINS = 16;
+    constexpr uint32_t MAX_LEAF = 16;  // triangles a leaf may keep when splitting does not pay
+    constexpr int MAX_DEPTH = 64;      // deeper ranges become leaves, bounding the traversal stack
+
+    struct Bounds {
+      Vector3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+      Vector3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+      void Grow(const Vector3& p) { min = Vector3Min(min, p); max = Vector3Max(max, p); }
+      void Grow(const Bounds& b) { min = Vector3Min(min, b.min); max = Vector3Max(max, b.max); }
+      float Area() const {
+	const Vector3 d = Vector3Subtract(max, min);
+	return d.x < 0.0f ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+      }
+    };
+
+    float Axis(const Vector3& v, int axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+    // slab test against a node's box; t is the entry distance
+    bool RayNode(const float* min, const float* max, const Vector3& origin, const float inv[3], float maxT, float& t) {
+      const float tx1 = (min[0] - origin.x) * inv[0], tx2 = (max[0] - origin.x) * inv[0];
+      const float ty1 = (min[1] - origin.y) * inv[1], ty2 = (max[1] - origin.y) * inv[1];
+      const float tz1 = (min[2] - origin.z) * inv[2], tz2 = (max[2] - origin.z) * inv[2];
+      const float tmin = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+      const float tmax = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxT));
+      t = tmin;
+      return tmin <= tmax;
+    }
+  }
+
+  void MeshBVH::Build(const Mesh& mesh) {
+    m_Nodes.clear();
+    m_Packets.clear();
+    m_TriangleCount = mesh.vertices ? (uint32_t)mesh.triangleCount : 0;
+    if (m_TriangleCount == 0) return;
+
+    auto vertex = [&mesh](uint32_t tri, int corner) {
+      const uint32_t i = mesh.indices ? mesh.indices[tri * 3 + corner] : tri * 3 + corner;
+      return Vector3{ mesh.vertices[i * 3], mesh.vertices[i * 3 + 1], mesh.vertices[i * 3 + 2] };
+    };
+
+    const uint32_t n = m_TriangleCount;
+    std::vector<Bounds> boxes(n);
+    std::vector<Vector3> centroids(n);
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; ++i) {
+      for (int c = 0; c < 3; ++c) boxes[i].Grow(vertex(i, c));
+      centroids[i] = Vector3Scale(Vector3Add(boxes[i].min, boxes[i].max), 0.5f);
+      order[i] = i;
+    }
+
+    // leaves write their triangles out as soon as they are final
+    auto makeLeaf = [&](Node& node, uint32_t first, uint32_t count) {
+      node.first = (uint32_t)m_Packets.size();
+      node.count = (count + 3) / 4;
+      for (uint32_t i = 0; i < count; i += 4) {
+	Packet packet{};
+	for (uint32_t lane = 0; lane < 4; ++lane) {
+	  packet.index[lane] = -1;
+	  if (i + lane >= count) continue;
+	  const uint32_t tri = order[first + i + lane];
+	  const Vector3 v0 = vertex(tri, 0);
+	  const Vector3 e1 = Vector3Subtract(vertex(tri, 1), v0);
+	  const Vector3 e2 = Vector3Subtract(vertex(tri, 2), v0);
+	  for (int a = 0; a < 3; ++a) {
+	    packet.v0[a][lane] = Axis(v0, a);
+	    packet.e1[a][lane] = Axis(e1, a);
+	    packet.e2[a][lane] = Axis(e2, a);
+	  }
+	  packet.index[lane] = (int32_t)tri;
+	}
+	m_Packets.push_back(packet);
+      }
+    };
+
+    struct Range { uint32_t node, first, count; int depth; };
+    std::vector<Range> stack;
+    stack.push_back({ 0, 0, n, 0 });
+    m_Nodes.reserve(2 * (n / 4 + 1));
+    m_Nodes.emplace_back();
+
+    while (!stack.empty()) {
+      const Range range = stack.back();
+      stack.pop_back();
+
+      Bounds box, centroidBox;
+      for (uint32_t i = range.first; i < range.first + range.count; ++i) {
+	box.Grow(boxes[order[i]]);
+	centroidBox.Grow(centroids[order[i]]);
+      }
+      Node& node = m_Nodes[range.node];
+      node.min[0] = box.min.x; node.min[1] = box.min.y; node.min[2] = box.min.z;
+      node.max[0] = box.max.x; node.max[1] = box.max.y; node.max[2] = box.max.z;
+
+      if (range.count <= 4 || range.depth >= MAX_DEPTH) {
+	makeLeaf(node, range.first, range.count);
+	continue;
+      }
+
+      // binned SAH: cost of a split relative to testing every triangle here
+      int bestAxis = -1, bestBin = 0;
+      float bestCost = (float)range.count * box.Area();
+      for (int axis = 0; axis < 3; ++axis) {
+	const float lo = Axis(centroidBox.min, axis);
+	const float extent = Axis(centroidBox.max, axis) - lo;
+	if (extent <= 0.0f) continue;
+	const float scale = BINS / extent;
+
+	Bounds binBox[BINS];
+	uint32_t binCount[BINS] = {};
+	for (uint32_t i = range.first; i < range.first + range.count; ++i) {
+	  const int b = std::min(BINS - 1, (int)((Axis(centroids[order[i]], axis) - lo) * scale));
+	  binCount[b]++;
+	  binBox[b].Grow(boxes[order[i]]);
+	}
+
+	float leftArea[BINS - 1];
+	uint32_t leftCount[BINS - 1];
+	Bounds left;
+	uint32_t count = 0;
+	for (int b = 0; b < BINS - 1; ++b) {
+	  left.Grow(binBox[b]);
+	  count += binCount[b];
+	  leftArea[b] = left.Area();
+	  leftCount[b] = count;
+	}
+	Bounds right;
+	count = 0;
+	for (int b = BINS - 1; b > 0; --b) {
+	  right.Grow(binBox[b]);
+	  count += binCount[b];
+	  const float cost = leftCount[b - 1] * leftArea[b - 1] + count * right.Area() + box.Area();
+	  if (cost < bestCost) {
+	    bestCost = cost;
+	    bestAxis = axis;
+	    bestBin = b - 1;
+	  }
+	}
+      }
+
+      uint32_t mid = range.first;
+      if (bestAxis >= 0) {
+	const float lo = Axis(centroidBox.min, bestAxis);
+	const float scale = BINS / (Axis(centroidBox.max, bestAxis) - lo);
+	auto* begin = order.data() + range.first;
+	mid = (uint32_t)(std::partition(begin, begin + range.count, [&](uint32_t tri) {
+	  return std::min(BINS - 1, (int)((Axis(centroids[tri], bestAxis) - lo) * scale)) <= bestBin;
+	}) - order.data());
+      } else if (range.count <= MAX_LEAF) {
+	makeLeaf(node, range.first, range.count);
+	continue;
+      }
+      // nothing worth splitting on but too many for one leaf: halve the range
+      if (mid == range.first || mid == range.first + range.count)
+	mid = range.first + range.count / 2;
+
+      const uint32_t child = (uint32_t)m_Nodes.size();
+      node.first = child;
+      node.count = 0;
+      m_Nodes.emplace_back();
+      m_Nodes.emplace_back();
+      stack.push_back({ child, range.first, mid - range.first, range.depth + 1 });
+      stack.push_back({ child + 1, mid, range.first + range.count - mid, range.depth + 1 });
+    }
+  }
+
+  // Moller-Trumbore on the four triangles of a packet, both faces. Updates hit
+  // and returns true if one is closer than `best`.
+  bool MeshBVH::IntersectPacket(const Packet& p, const Ray& ray, float best, MeshHit& hit) {
+    float t[4], u[4], v[4];
+    int mask = 0;
+
+#ifdef RE_MESHBVH_SSE
+    const __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+    const __m128 e1x = _mm_load_ps(p.e1[0]), e1y = _mm_load_ps(p.e1[1]), e1z = _mm_load_ps(p.e1[2]);
+    const __m128 e2x = _mm_load_ps(p.e2[0]), e2y = _mm_load_ps(p.e2[1]), e2z = _mm_load_ps(p.e2[2]);
+
+    // pvec = d x e2, det = e1 . pvec
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    const __m128 tx = _mm_sub_ps(_mm_set1_ps(ray.position.x), _mm_load_ps(p.v0[0]));
+    const __m128 ty = _mm_sub_ps(_mm_set1_ps(ray.position.y), _mm_load_ps(p.v0[1]));
+    const __m128 tz = _mm_sub_ps(_mm_set1_ps(ray.position.z), _mm_load_ps(p.v0[2]));
+    const __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+    // qvec = tvec x e1
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    const __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+    const __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 ok = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f)); // padding lanes have det 0
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(uu, zero));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(vv, zero));
+    ok = _mm_and_ps(ok, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+    ok = _mm_and_ps(ok, _mm_cmpge_ps(tt, zero));
+    ok = _mm_and_ps(ok, _mm_cmplt_ps(tt, _mm_set1_ps(best)));
+    mask = _mm_movemask_ps(ok);
+    if (!mask) return false;
+    _mm_storeu_ps(t, tt);
+    _mm_storeu_ps(u, uu);
+    _mm_storeu_ps(v, vv);
+#else
+    const Vector3 d = ray.direction;
+    for (int lane = 0; lane < 4; ++lane) {
+      const Vector3 e1 = { p.e1[0][lane], p.e1[1][lane], p.e1[2][lane] };
+      const Vector3 e2 = { p.e2[0][lane], p.e2[1][lane], p.e2[2][lane] };
+      const Vector3 pv = Vector3CrossProduct(d, e2);
+      const float det = Vector3DotProduct(e1, pv);
+      if (fabsf(det) <= 1e-12f) continue;
+      const float invDet = 1.0f / det;
+      const Vector3 tv = { ray.position.x - p.v0[0][lane], ray.position.y - p.v0[1][lane], ray.position.z - p.v0[2][lane] };
+      u[lane] = Vector3DotProduct(tv, pv) * invDet;
+      const Vector3 qv = Vector3CrossProduct(tv, e1);
+      v[lane] = Vector3DotProduct(d, qv) * invDet;
+      t[lane] = Vector3DotProduct(e2, qv) * invDet;
+      if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && t[lane] >= 0.0f && t[lane] < best)
+	mask |= 1 << lane;
+    }
+    if (!mask) return false;
+#endif
+
+    int lane = -1;
+    for (int i = 0; i < 4; ++i)
+      if ((mask & (1 << i)) && (lane < 0 || t[i] < t[lane])) lane = i;
+    hit.distance = t[lane];
+    hit.triangle = p.index[lane];
+    hit.u = u[lane];
+    hit.v = v[lane];
+    return true;
+  }
+
+  bool MeshBVH::RayCast(const Ray& ray, float maxDistance, MeshHit& hit) const {
+    if (m_Nodes.empty()) return false;
+    const float inv[3] = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+
+    float best = maxDistance;
+    bool found = false;
+    struct Item { uint32_t node; float t; };
+    Item stack[MAX_DEPTH + 2];
+    int top = 0;
+
+    float t;
+    if (!RayNode(m_Nodes[0].min, m_Nodes[0].max, ray.position, inv, best, t)) return false;
+    stack[top++] = { 0, t };
+    while (top > 0) {
+      const Item item = stack[--top];
+      if (item.t > best) continue; // a closer hit was found since it was pushed
+      const Node& node = m_Nodes[item.node];
+
+      if (node.count) {
+	for (uint32_t i = node.first; i < node.first + node.count; ++i)
+	  if (IntersectPacket(m_Packets[i], ray, best, hit)) {
+	    best = hit.distance;
+	    found = true;
+	  }
+	continue;
+      }
+
+      const Node& a = m_Nodes[node.first];
+      const Node& b = m_Nodes[node.first + 1];
+      float ta, tb;
+      const bool hitA = RayNode(a.min, a.max, ray.position, inv, best, ta);
+      const bool hitB = RayNode(b.min, b.max, ray.position, inv, best, tb);
+      // the nearer child is popped first
+      if (hitA && hitB) {
+	if (ta <= tb) {
+	  stack[top++] = { node.first + 1, tb };
+	  stack[top++] = { node.first, ta };
+	} else {
+	  stack[top++] = { node.first, ta };
+	  stack[top++] = { node.first + 1, tb };
+	}
+      } else if (hitA)
+	stack[top++] = { node.first, ta };
+      else if (hitB)
+	stack[top++] = { node.first + 1, tb };
+    }
+    return found;
+  }
+
+  ModelBVH::ModelBVH(const Model& model) {
+    // meshes build independently
+    meshes.resize(model.meshCount);
+    ThreadPool::Get().ParallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+	meshes[i].Build(model.meshes[i]);
+    });
+  }
+
+  bool ModelBVH::RayCast(const Ray& ray, const Matrix& transform, float maxDistance, MeshHit& hit) const {
+    // into model space; the direction is left unnormalized so distances carry over
+    const Matrix inv = MatrixInvert(transform);
+    const Vector3 d = ray.direction;
+    const Ray local = {
+      Vector3Transform(ray.position, inv),
+      { inv.m0 * d.x + inv.m4 * d.y + inv.m8 * d.z,
+	inv.m1 * d.x + inv.m5 * d.y + inv.m9 * d.z,
+	inv.m2 * d.x + inv.m6 * d.y + inv.m10 * d.z }
+    };
+
+    bool found = false;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+      MeshHit meshHit;
+      if (!meshes[i].RayCast(local, maxDistance, meshHit)) continue;
+      hit = meshHit;
+      hit.mesh = (int)i;
+      maxDistance = meshHit.distance;
+      found = true;
+    }
+    return found;
+  }
+}
@@ -1,12 +1,41 @@
 #include "repch.h"
 #include "Auxiliaries/Physics.h"
 #include <btBulletDynamicsCommon.h>
+#include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <LinearMath/btQuickprof.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
 #include <stdexcept>
 #include <cstring> // memcpy
 #include <iostream>
+#include <bit>
+#include <chrono>
 
 namespace RE {
 
+  // --- Layer filter ------------------------------------------------------------------
+  // Rejects pairs in the broadphase so filtered layers never create manifolds.
+  // Groups are one-hot layer bits; anything else falls back to Bullet's group/mask test.
+  struct LayerFilterCallback : public btOverlapFilterCallback {
+    const CollisionMatrix* matrix = nullptr;
+
+    explicit LayerFilterCallback(const CollisionMatrix* m) : matrix(m) {}
+
+    bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const override {
+      const uint32_t group0 = static_cast<uint32_t>(proxy0->m_collisionFilterGroup);
+      const uint32_t group1 = static_cast<uint32_t>(proxy1->m_collisionFilterGroup);
+      bool collides = (group0 & static_cast<uint32_t>(proxy1->m_collisionFilterMask)) != 0;
+      collides = collides && (group1 & static_cast<uint32_t>(proxy0->m_collisionFilterMask)) != 0;
+      if (!collides || !matrix) return collides;
+
+      if (std::has_single_bit(group0) && std::has_single_bit(group1)) {
+        const auto layer0 = static_cast<CollisionLayer>(std::countr_zero(group0));
+        const auto layer1 = static_cast<CollisionLayer>(std::countr_zero(group1));
+        return matrix->Collides(layer0, layer1);
+      }
+      return collides;
+    }
+  };
+
   // --- Helpers to convert between simple float arrays and btTransform ----------------
   btTransform Physics3D::ToBtTransform(const Vector3& pos, const float tr[4]) const {
     btTransform t;
@@ -58,6 +87,14 @@ namespace RE {
     // Dynamics world
     m_dynamicsWorld = new btDiscreteDynamicsWorld(m_dispatcher, m_broadphase, m_solver, m_collisionConfig);
 
+    // layer filtering on the broadphase pair cache
+    m_filterCallback = new LayerFilterCallback(&m_layerMatrix);
+    m_broadphase->getOverlappingPairCache()->setOverlapFilterCallback(m_filterCallback);
+
+    // lets ghost objects keep their own overlap list in sync with the broadphase
+    m_ghostPairCallback = new btGhostPairCallback();
+    m_broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(m_ghostPairCallback);
+
     // sensible default gravity (y-down)
     m_dynamicsWorld->setGravity(btVector3(0.0f, -9.81f, 0.0f));
 
@@ -76,7 +113,75 @@ namespace RE {
     if (maxSubSteps < 0) maxSubSteps = 1;
     if (fixedStep <= 0.0f) fixedStep = 1.0f / 60.0f;
 
-    m_dynamicsWorld->stepSimulation(ts, maxSubSteps, fixedStep);
+    const auto start = std::chrono::steady_clock::now();
+    const int subSteps = m_dynamicsWorld->stepSimulation(ts, maxSubSteps, fixedStep);
+    const auto end = std::chrono::steady_clock::now();
+
+    UpdateTriggers();
+    CollectStats(subSteps, std::chrono::duration<float, std::milli>(end - start).count());
+  }
+
+  // --- Stats ----------------------------------------------------------------------
+  void Physics3D::CollectStats(int subSteps, float stepMs) {
+    auto& stats = m_stats;
+    stats.subSteps = subSteps;
+    stats.stepMs = stepMs;
+    stats.broadphasePairs = m_broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+
+    btDispatcher* dispatcher = m_dynamicsWorld->getDispatcher();
+    stats.manifolds = dispatcher->getNumManifolds();
+    stats.touchingManifolds = 0;
+    stats.contacts = 0;
+    for (int i = 0; i < stats.manifolds; ++i) {
+      const int contacts = dispatcher->getManifoldByIndexInternal(i)->getNumContacts();
+      stats.contacts += contacts;
+      if (contacts > 0) stats.touchingManifolds++;
+    }
+
+    // island tags are assigned by calculateSimulationIslands during the step
+    stats.activeBodies = stats.sleepingBodies = stats.staticBodies = 0;
+    m_islandScratch.clear();
+    for (btRigidBody* body : m_ownedBodies) {
+      if (body->isStaticObject()) { stats.staticBodies++; continue; }
+      if (body->getActivationState() == ISLAND_SLEEPING) stats.sleepingBodies++;
+      else stats.activeBodies++;
+      if (body->getIslandTag() >= 0) m_islandScratch.push_back(body->getIslandTag());
+    }
+    std::sort(m_islandScratch.begin(), m_islandScratch.end());
+    stats.islands = static_cast<int>(std::unique(m_islandScratch.begin(), m_islandScratch.end()) - m_islandScratch.begin());
+
+    stats.triggers = static_cast<int>(m_triggers.size());
+    stats.triggerEvents = static_cast<int>(m_triggerEvents.size());
+
+    // stepSimulation resets CProfileManager on entry, so the tree holds this step only
+    stats.phases.clear();
+    CProfileIterator* it = CProfileManager::Get_Iterator();
+    if (it) {
+      CollectPhases(it, 0);
+      CProfileManager::Release_Iterator(it);
+    }
+  }
+
+  void Physics3D::CollectPhases(CProfileIterator* it, int depth) {
+    constexpr int maxDepth = 4;
+
+    it->First();
+    int children = 0;
+    for (; !it->Is_Done(); it->Next()) children++;
+
+    for (int i = 0; i < children; ++i) {
+      // the iterator is positioned by index; read the child before descending
+      it->First();
+      for (int n = 0; n < i; ++n) it->Next();
+      m_stats.phases.push_back({ it->Get_Current_Name(), it->Get_Current_Total_Time(),
+                                 it->Get_Current_Total_Calls(), depth });
+
+      if (depth + 1 < maxDepth) {
+        it->Enter_Child(i);
+        CollectPhases(it, depth + 1);
+        it->Enter_Parent();
+      }
+    }
   }
 
   // --- Shutdown -------------------------------------------------------------------
@@ -88,7 +193,7 @@ namespace RE {
       btRigidBody* body = *it;
       if (!body) continue;
       // remove from world if present
-      if (m_dynamicsWorld->getCollisionObjectArray().findLinearSearch(body) != -1) {
+      if (body->isInWorld()) {
 	m_dynamicsWorld->removeRigidBody(body);
       }
       // delete motion state and body
@@ -98,11 +203,20 @@ namespace RE {
     }
     m_ownedBodies.clear();
 
+    // remove and delete triggers
+    for (auto& trigger : m_triggers) {
+      m_dynamicsWorld->removeCollisionObject(trigger.ghost);
+      delete trigger.ghost;
+    }
+    m_triggers.clear();
+    m_triggerEvents.clear();
+
     // delete shapes
     for (auto s : m_ownedShapes) {
       delete s;
     }
     m_ownedShapes.clear();
+    m_shapeUsers.clear();
 
     // delete world objects
     delete m_dynamicsWorld;
@@ -115,6 +229,10 @@ namespace RE {
     m_collisionConfig = nullptr;
     delete m_broadphase;
     m_broadphase = nullptr;
+    delete m_filterCallback;
+    m_filterCallback = nullptr;
+    delete m_ghostPairCallback;
+    m_ghostPairCallback = nullptr;
 
     m_initialized = false;
   }
@@ -206,70 +324,294 @@ namespace RE {
   }
 
 
+  btCollisionShape* Physics3D::CreateCompoundShape(const std::vector<CompoundChild>& children) {
+    auto* compound = new btCompoundShape(true, static_cast<int>(children.size()));
+    for (const auto& child : children) {
+      if (!child.shape) continue;
+      btTransform local;
+      local.setIdentity();
+      local.setOrigin(btVector3(child.offset.x, child.offset.y, child.offset.z));
+      local.setRotation(btQuaternion(btScalar(child.rotation.z), btScalar(child.rotation.y), btScalar(child.rotation.x)));
+      compound->addChildShape(local, child.shape);
+    }
+    m_ownedShapes.push_back(compound);
+    return compound;
+  }
+
+  btCollisionShape* Physics3D::CreateHeightfieldShape(int width, int length, const int16_t* heights, float heightScale,
+                                                      int16_t minHeight, int16_t maxHeight, float cellSize) {
+    if (!heights || width < 2 || length < 2) return nullptr;
+    auto* s = new btHeightfieldTerrainShape(width, length, heights, heightScale,
+                                            btScalar(minHeight) * heightScale, btScalar(maxHeight) * heightScale,
+                                            1, PHY_SHORT, false);
+    s->setLocalScaling(btVector3(cellSize, 1.0f, cellSize));
+    m_ownedShapes.push_back(s);
+    return s;
+  }
+
   // --- Add / Remove rigid body ---------------------------------------------------
-  void* Physics3D::AddRigidBody(btCollisionShape* shape, float mass,const Vector3& pos, const Vector3& rotation) {
-    if (!m_initialized) return nullptr;
-    if (!shape) return nullptr;
+  void* Physics3D::AddRigidBody(btCollisionShape* shape, float mass,const Vector3& pos, const Vector3& rotation,
+                                CollisionLayer layer) {
+    void* body = nullptr;
+    AddRigidBodies(shape, mass, &pos, &rotation, 1, layer, &body);
+    return body;
+  }
+
+  void Physics3D::AddRigidBodies(btCollisionShape* shape, float mass, const Vector3* positions, const Vector3* rotations,
+                                 size_t count, CollisionLayer layer, void** outBodies) {
+    std::fill(outBodies, outBodies + count, nullptr);
+    if (!m_initialized) return;
+    if (!shape || count == 0) return;
 
-    // calculate local inertia
+    // calculate local inertia, once for all bodies sharing the shape
     btVector3 localInertia(0,0,0);
     if (mass > 0.0f) shape->calculateLocalInertia(mass, localInertia);
 
-    // transform
-    // btTransform start = ToBtTransform(pos,startTransform);
-    btTransform start;
-    start.setIdentity();
-    start.setOrigin(btVector3(pos.x, pos.y, pos.z));
-    start.setRotation(btQuaternion(btScalar(rotation.z), btScalar(rotation.y), btScalar(rotation.x)));
+    // add to world with the layer's group bit and matrix mask
+    if (layer >= MAX_COLLISION_LAYERS) layer = CollisionLayers::Default;
+    const int group = static_cast<int>(1u << layer);
+    const int mask = static_cast<int>(m_layerMatrix.GetMask(layer));
+
+    m_ownedBodies.reserve(m_ownedBodies.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+      // transform
+      btTransform start;
+      start.setIdentity();
+      start.setOrigin(btVector3(positions[i].x, positions[i].y, positions[i].z));
+      start.setRotation(btQuaternion(btScalar(rotations[i].z), btScalar(rotations[i].y), btScalar(rotations[i].x)));
+
+      // motion state
+      btDefaultMotionState* motion = new btDefaultMotionState(start);
+
+      // construction
+      btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motion, shape, localInertia);
+      btRigidBody* body = new btRigidBody(rbInfo);
+      m_dynamicsWorld->addRigidBody(body, group, mask);
+
+      // track for cleanup
+      m_ownedBodies.push_back(body);
+      outBodies[i] = static_cast<void*>(body);
+    }
+    m_shapeUsers[shape] += static_cast<uint32_t>(count);
+  }
+
+  void Physics3D::RemoveRigidBody(void* bodyHandle, bool destroyShape) {
+    RemoveRigidBodies(&bodyHandle, 1, destroyShape);
+  }
+
+  void Physics3D::RemoveRigidBodies(void* const* bodyHandles, size_t count, bool destroyShapes) {
+    if (!m_initialized) return;
+
+    std::unordered_set<btCollisionObject*> doomed;
+    std::vector<btCollisionShape*> shapes;
+    doomed.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      btRigidBody* body = static_cast<btRigidBody*>(bodyHandles[i]);
+      if (!body || !doomed.insert(body).second) continue;
+      // remove from world
+      m_dynamicsWorld->removeRigidBody(body);
+      shapes.push_back(body->getCollisionShape());
+    }
+    if (doomed.empty()) return;
+
+    // no exit event may point at a freed body
+    ForgetTriggerOverlaps(doomed);
 
-    // motion state
-    btDefaultMotionState* motion = new btDefaultMotionState(start);
+    // one sweep of the owned list; bodies not found in it are still deleted
+    m_ownedBodies.erase(std::remove_if(m_ownedBodies.begin(), m_ownedBodies.end(),
+                                       [&doomed](btRigidBody* body) { return doomed.count(body) != 0; }),
+                        m_ownedBodies.end());
+    for (btCollisionObject* object : doomed) {
+      btRigidBody* body = static_cast<btRigidBody*>(object);
+      btMotionState* ms = body->getMotionState();
+      delete body;
+      if (ms) delete ms;
+    }
 
-    // construction
-    btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motion, shape, localInertia);
-    btRigidBody* body = new btRigidBody(rbInfo);
+    // optionally delete shapes if owned and no other body still uses them
+    if (destroyShapes) {
+      shapes.erase(std::remove_if(shapes.begin(), shapes.end(),
+                                  [this](btCollisionShape* shape) { return !ReleaseShapeUser(shape); }),
+                   shapes.end());
+      DestroyOwnedShapes(shapes);
+    }
+  }
 
-    // add to world
-    m_dynamicsWorld->addRigidBody(body);
+  bool Physics3D::ReleaseShapeUser(btCollisionShape* shape) {
+    auto it = m_shapeUsers.find(shape);
+    if (it == m_shapeUsers.end()) return true;
+    if (--it->second > 0) return false;
+    m_shapeUsers.erase(it);
+    return true;
+  }
 
-    // track for cleanup
-    m_ownedBodies.push_back(body);
+  // Only deletes shapes created via the Create* helpers above. One sweep of the
+  // owned list per level of compound nesting, however many shapes go.
+  void Physics3D::DestroyOwnedShapes(const std::vector<btCollisionShape*>& shapes) {
+    std::unordered_set<btCollisionShape*> doomed(shapes.begin(), shapes.end());
+    std::vector<btCollisionShape*> owned;
+    while (!doomed.empty()) {
+      const size_t first = owned.size();
+      m_ownedShapes.erase(std::remove_if(m_ownedShapes.begin(), m_ownedShapes.end(),
+                                         [&](btCollisionShape* shape) {
+                                           if (!doomed.count(shape)) return false;
+                                           owned.push_back(shape);
+                                           return true;
+                                         }),
+                          m_ownedShapes.end());
+
+      // compounds created by CreateCompoundShape take their children with them
+      doomed.clear();
+      for (size_t i = first; i < owned.size(); ++i) {
+        if (!owned[i]->isCompound()) continue;
+        auto* compound = static_cast<btCompoundShape*>(owned[i]);
+        for (int c = 0; c < compound->getNumChildShapes(); ++c) {
+          doomed.insert(compound->getChildShape(c));
+        }
+      }
+    }
+    for (btCollisionShape* shape : owned) {
+      delete shape;
+    }
+  }
 
-    return static_cast<void*>(body);
+  // --- Triggers ------------------------------------------------------------------
+  void* Physics3D::AddTrigger(btCollisionShape* shape, const Vector3& pos, const Vector3& rotation,
+                              CollisionLayer layer) {
+    void* trigger = nullptr;
+    AddTriggers(shape, &pos, &rotation, 1, layer, &trigger);
+    return trigger;
   }
 
-  void Physics3D::RemoveRigidBody(void* bodyHandle, bool destroyShape) {
+  void Physics3D::AddTriggers(btCollisionShape* shape, const Vector3* positions, const Vector3* rotations,
+                              size_t count, CollisionLayer layer, void** outTriggers) {
+    std::fill(outTriggers, outTriggers + count, nullptr);
     if (!m_initialized) return;
-    if (!bodyHandle) return;
-    btRigidBody* body = static_cast<btRigidBody*>(bodyHandle);
+    if (!shape || count == 0) return;
+
+    if (layer >= MAX_COLLISION_LAYERS) layer = CollisionLayers::Trigger;
+    const int group = static_cast<int>(1u << layer);
+    const int mask = static_cast<int>(m_layerMatrix.GetMask(layer));
+
+    m_triggers.reserve(m_triggers.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+      btTransform start;
+      start.setIdentity();
+      start.setOrigin(btVector3(positions[i].x, positions[i].y, positions[i].z));
+      start.setRotation(btQuaternion(btScalar(rotations[i].z), btScalar(rotations[i].y), btScalar(rotations[i].x)));
+
+      auto* ghost = new btPairCachingGhostObject();
+      ghost->setCollisionShape(shape);
+      ghost->setWorldTransform(start);
+      ghost->setCollisionFlags(ghost->getCollisionFlags() | btCollisionObject::CF_NO_CONTACT_RESPONSE);
+      m_dynamicsWorld->addCollisionObject(ghost, group, mask);
+
+      m_triggers.push_back({ ghost, {} });
+      outTriggers[i] = static_cast<void*>(static_cast<btCollisionObject*>(ghost));
+    }
+    m_shapeUsers[shape] += static_cast<uint32_t>(count);
+  }
 
-    // remove from world
-    m_dynamicsWorld->removeRigidBody(body);
+  void Physics3D::RemoveTrigger(void* triggerHandle, bool destroyShape) {
+    RemoveTriggers(&triggerHandle, 1, destroyShape);
+  }
 
-    // remove from owned list
-    auto it = std::find(m_ownedBodies.begin(), m_ownedBodies.end(), body);
-    if (it != m_ownedBodies.end()) {
-      // delete motion state
-      btMotionState* ms = body->getMotionState();
-      delete body;
-      if (ms) delete ms;
-      m_ownedBodies.erase(it);
-    } else {
-      // if not found, still delete
-      btMotionState* ms = body->getMotionState();
-      delete body;
-      if (ms) delete ms;
+  void Physics3D::RemoveTriggers(void* const* triggerHandles, size_t count, bool destroyShapes) {
+    if (!m_initialized) return;
+
+    std::unordered_set<btCollisionObject*> doomed;
+    doomed.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      if (triggerHandles[i]) doomed.insert(static_cast<btCollisionObject*>(triggerHandles[i]));
+    }
+    if (doomed.empty()) return;
+
+    std::vector<btCollisionShape*> shapes;
+    auto removed = [&](TriggerState& trigger) {
+      btCollisionObject* object = trigger.ghost;
+      if (!doomed.count(object)) return false;
+      shapes.push_back(trigger.ghost->getCollisionShape());
+      m_dynamicsWorld->removeCollisionObject(trigger.ghost);
+      delete trigger.ghost;
+      return true;
+    };
+    m_triggers.erase(std::remove_if(m_triggers.begin(), m_triggers.end(), removed), m_triggers.end());
+    ForgetTriggerOverlaps(doomed);
+
+    if (destroyShapes) {
+      shapes.erase(std::remove_if(shapes.begin(), shapes.end(),
+                                  [this](btCollisionShape* shape) { return !ReleaseShapeUser(shape); }),
+                   shapes.end());
+      DestroyOwnedShapes(shapes);
+    }
+  }
+
+  void Physics3D::SetTriggerTransform(void* triggerHandle, const Vector3& pos, const Vector3& rotation) {
+    if (!m_initialized) return;
+    if (!triggerHandle) return;
+    btTransform t;
+    t.setIdentity();
+    t.setOrigin(btVector3(pos.x, pos.y, pos.z));
+    t.setRotation(btQuaternion(btScalar(rotation.z), btScalar(rotation.y), btScalar(rotation.x)));
+    static_cast<btCollisionObject*>(triggerHandle)->setWorldTransform(t);
+  }
+
+  void Physics3D::ForgetTriggerOverlaps(const std::unordered_set<btCollisionObject*>& objects) {
+    for (auto& trigger : m_triggers) {
+      auto& overlaps = trigger.overlaps;
+      overlaps.erase(std::remove_if(overlaps.begin(), overlaps.end(),
+                                    [&objects](btCollisionObject* object) { return objects.count(object) != 0; }),
+                     overlaps.end());
     }
+  }
 
-    // optionally delete shape if owned (crude: search owned shapes list and delete)
-    if (destroyShape) {
-      // try to find shape pointer in owned shapes and delete if found
-      // This assumes shapes were created via Create* helpers above.
-      auto sit = std::find(m_ownedShapes.begin(), m_ownedShapes.end(), body->getCollisionShape());
-      if (sit != m_ownedShapes.end()) {
-	delete *sit;
-	m_ownedShapes.erase(sit);
+  // Diff each ghost's broadphase overlap list against the last step. Cost scales with
+  // the number of overlaps, not with the number of bodies in the world.
+  void Physics3D::UpdateTriggers() {
+    m_triggerEvents.clear();
+
+    for (auto& trigger : m_triggers) {
+      auto& current = m_overlapScratch;
+      current.clear();
+      const int count = trigger.ghost->getNumOverlappingObjects();
+      for (int i = 0; i < count; ++i) {
+        current.push_back(trigger.ghost->getOverlappingObject(i));
       }
+      std::sort(current.begin(), current.end());
+
+      void* handle = static_cast<void*>(static_cast<btCollisionObject*>(trigger.ghost));
+      auto prev = trigger.overlaps.begin();
+      auto curr = current.begin();
+      while (prev != trigger.overlaps.end() || curr != current.end()) {
+        if (curr == current.end() || (prev != trigger.overlaps.end() && *prev < *curr)) {
+          m_triggerEvents.push_back({ handle, static_cast<void*>(*prev), false });
+          ++prev;
+        } else if (prev == trigger.overlaps.end() || *curr < *prev) {
+          m_triggerEvents.push_back({ handle, static_cast<void*>(*curr), true });
+          ++curr;
+        } else {
+          ++prev;
+          ++curr;
+        }
+      }
+
+      trigger.overlaps.swap(current);
+    }
+  }
+
+  // --- Collision layers ------------------------------------------------------------
+  void Physics3D::SetLayerCollision(CollisionLayer a, CollisionLayer b, bool collide) {
+    m_layerMatrix.Set(a, b, collide);
+
+    // keep proxy masks in sync so Bullet's own group/mask test agrees with the matrix
+    if (!m_initialized) return;
+    for (btRigidBody* body : m_ownedBodies) {
+      btBroadphaseProxy* proxy = body ? body->getBroadphaseHandle() : nullptr;
+      if (!proxy) continue;
+      const uint32_t group = static_cast<uint32_t>(proxy->m_collisionFilterGroup);
+      if (!std::has_single_bit(group)) continue;
+      const auto layer = static_cast<CollisionLayer>(std::countr_zero(group));
+      proxy->m_collisionFilterMask = static_cast<int>(m_layerMatrix.GetMask(layer));
     }
   }
 
@@ -0,0 +1,48 @@
+#include "repch.h"
+#include "Core/StringID.h"
+#include <mutex>
+#include <shared_mutex>
+
+namespace RE {
+
+  namespace {
+    struct InternTable {
+      std::shared_mutex mutex;
+      // node based: the stored strings never move, so resolved views stay valid
+      std::unordered_map<StringID, std::string> strings;
+    };
+
+    InternTable& GetTable() {
+      static InternTable table;
+      return table;
+    }
+  }
+
+  StringID StringInterner::Intern(std::string_view str) {
+    const StringID id = HashString(str);
+    InternTable& table = GetTable();
+    {
+      std::shared_lock<std::shared_mutex> lock(table.mutex);
+      auto it = table.strings.find(id);
+      if (it != table.strings.end()) {
+#ifdef RE_DEBUG
+	if (it->second != str)
+	  TraceLog(LOG_ERROR, "StringID collision: \"%.*s\" and \"%s\" both hash to %08x",
+		   (int)str.size(), str.data(), it->second.c_str(), id);
+#endif
+	return id;
+      }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    table.strings.try_emplace(id, str);
+    return id;
+  }
+
+  std::string_view StringInterner::Resolve(StringID id) {
+    InternTable& table = GetTable();
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    auto it = table.strings.find(id);
+    return it != table.strings.end() ? std::string_view(it->second) : std::string_view();
+  }
+}
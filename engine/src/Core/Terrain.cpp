@@ -0,0 +1,323 @@
+#include "repch.h"
+#include "Auxiliaries/Terrain.h"
+#include "Auxiliaries/rayext.h"
+#include <cmath>
+#include <filesystem>
+
+namespace RE {
+
+  // --- Loading ---------------------------------------------------------------------
+  Terrain::~Terrain() {
+    Unload();
+  }
+
+  bool Terrain::LoadHeightmap(const std::string& path, const TerrainSettings& settings) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+    if (ext == ".r16" || ext == ".raw") {
+      int size = 0;
+      unsigned char* bytes = LoadFileData(path.c_str(), &size);
+      if (!bytes) return false;
+
+      const int samples = size / 2;
+      const int side = (int)std::lround(std::sqrt((double)samples));
+      if (side < 2 || side * side * 2 != size) {
+	TraceLog(LOG_ERROR, "Terrain: %s is not a square 16-bit heightmap", path.c_str());
+	UnloadFileData(bytes);
+	return false;
+      }
+
+      // little-endian regardless of host
+      std::vector<uint16_t> heights(samples);
+      for (int i = 0; i < samples; ++i)
+	heights[i] = (uint16_t)(bytes[i * 2] | (bytes[i * 2 + 1] << 8));
+      UnloadFileData(bytes);
+      return LoadFromData(heights.data(), side, side, settings);
+    }
+
+    Image image = LoadImage(path.c_str());
+    if (!image.data) return false;
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+
+    const unsigned char* pixels = static_cast<const unsigned char*>(image.data);
+    std::vector<uint16_t> heights((size_t)image.width * image.height);
+    for (size_t i = 0; i < heights.size(); ++i)
+      heights[i] = (uint16_t)(pixels[i] * 257);
+    const int width = image.width, length = image.height;
+    UnloadImage(image);
+    return LoadFromData(heights.data(), width, length, settings);
+  }
+
+  bool Terrain::LoadFromData(const uint16_t* heights, int width, int length, const TerrainSettings& settings) {
+    Unload();
+    if (!heights || width < 2 || length < 2) return false;
+
+    m_Settings = settings;
+    m_Settings.chunkQuads = std::clamp(m_Settings.chunkQuads, 1, 254);
+    m_Settings.lodCount = std::clamp(m_Settings.lodCount, 1, 8);
+    m_Width = width;
+    m_Length = length;
+
+    m_Heights.resize((size_t)width * length);
+    m_MinRaw = std::numeric_limits<int16_t>::max();
+    m_MaxRaw = std::numeric_limits<int16_t>::min();
+    for (size_t i = 0; i < m_Heights.size(); ++i) {
+      const int16_t h = (int16_t)((int)heights[i] - 32768);
+      m_Heights[i] = h;
+      m_MinRaw = std::min(m_MinRaw, h);
+      m_MaxRaw = std::max(m_MaxRaw, h);
+    }
+
+    m_Material = LoadMaterialDefault();
+    m_HasMaterial = true;
+
+    BuildChunks();
+    return true;
+  }
+
+  void Terrain::Unload() {
+    for (auto& chunk : m_Chunks)
+      ReleaseChunkMesh(chunk);
+    m_Chunks.clear();
+    m_ChunksX = m_ChunksZ = 0;
+
+    if (m_HasMaterial) {
+      UnloadMaterial(m_Material);
+      m_Material = {};
+      m_HasMaterial = false;
+    }
+
+    m_Heights.clear();
+    m_Heights.shrink_to_fit();
+    m_Width = m_Length = 0;
+  }
+
+  // --- Queries ---------------------------------------------------------------------
+  float Terrain::GetHeight(int x, int z) const {
+    x = std::clamp(x, 0, m_Width - 1);
+    z = std::clamp(z, 0, m_Length - 1);
+    return ((float)m_Heights[(size_t)z * m_Width + x] + 32768.0f) * m_Settings.heightScale;
+  }
+
+  float Terrain::SampleHeight(float x, float z) const {
+    if (!IsLoaded()) return 0.0f;
+    const float fx = x / m_Settings.cellSize;
+    const float fz = z / m_Settings.cellSize;
+    const int ix = (int)std::floor(fx);
+    const int iz = (int)std::floor(fz);
+    const float tx = fx - ix;
+    const float tz = fz - iz;
+    const float h0 = GetHeight(ix, iz) + (GetHeight(ix + 1, iz) - GetHeight(ix, iz)) * tx;
+    const float h1 = GetHeight(ix, iz + 1) + (GetHeight(ix + 1, iz + 1) - GetHeight(ix, iz + 1)) * tx;
+    return h0 + (h1 - h0) * tz;
+  }
+
+  Vector3 Terrain::GetCollisionCenter() const {
+    const float hs = m_Settings.heightScale;
+    const float mid = ((float)m_MinRaw + (float)m_MaxRaw) * 0.5f * hs;
+    return { (m_Width - 1) * m_Settings.cellSize * 0.5f,
+	     32768.0f * hs + mid,
+	     (m_Length - 1) * m_Settings.cellSize * 0.5f };
+  }
+
+  Vector3 Terrain::SampleNormal(int x, int z) const {
+    const float dx = GetHeight(x - 1, z) - GetHeight(x + 1, z);
+    const float dz = GetHeight(x, z - 1) - GetHeight(x, z + 1);
+    return Vector3Normalize({ dx, 2.0f * m_Settings.cellSize, dz });
+  }
+
+  // --- Chunks ----------------------------------------------------------------------
+  void Terrain::BuildChunks() {
+    const int n = m_Settings.chunkQuads;
+    m_ChunksX = (m_Width - 1 + n - 1) / n;
+    m_ChunksZ = (m_Length - 1 + n - 1) / n;
+    m_Chunks.resize((size_t)m_ChunksX * m_ChunksZ);
+
+    const float cell = m_Settings.cellSize;
+    const float hs = m_Settings.heightScale;
+    for (int cz = 0; cz < m_ChunksZ; ++cz) {
+      for (int cx = 0; cx < m_ChunksX; ++cx) {
+	Chunk& chunk = m_Chunks[(size_t)cz * m_ChunksX + cx];
+	chunk.x0 = cx * n;
+	chunk.z0 = cz * n;
+	chunk.quadsX = std::min(n, m_Width - 1 - chunk.x0);
+	chunk.quadsZ = std::min(n, m_Length - 1 - chunk.z0);
+
+	int16_t lo = std::numeric_limits<int16_t>::max();
+	int16_t hi = std::numeric_limits<int16_t>::min();
+	for (int z = chunk.z0; z <= chunk.z0 + chunk.quadsZ; ++z) {
+	  for (int x = chunk.x0; x <= chunk.x0 + chunk.quadsX; ++x) {
+	    const int16_t h = m_Heights[(size_t)z * m_Width + x];
+	    lo = std::min(lo, h);
+	    hi = std::max(hi, h);
+	  }
+	}
+	chunk.bounds.min = { chunk.x0 * cell, ((float)lo + 32768.0f) * hs, chunk.z0 * cell };
+	chunk.bounds.max = { (chunk.x0 + chunk.quadsX) * cell, ((float)hi + 32768.0f) * hs,
+			     (chunk.z0 + chunk.quadsZ) * cell };
+      }
+    }
+  }
+
+  // sample offsets along one chunk side: every `step`th vertex plus the last one
+  static void ChunkAxis(int quads, int step, std::vector<int>& out) {
+    out.clear();
+    for (int i = 0; i < quads; i += step) out.push_back(i);
+    out.push_back(quads);
+  }
+
+  // Height of a vertex on an edge shared with a coarser neighbour: interpolate
+  // between the neighbour's samples so both sides produce the same line (no crack).
+  float Terrain::EdgeHeight(int x, int z, int along, int start, int length, int step, bool alongX) const {
+    const int a = (along / step) * step;
+    const int b = std::min(a + step, length);
+    if (a == along || b == a) return GetHeight(x, z);
+    const float t = (float)(along - a) / (float)(b - a);
+    const float ha = alongX ? GetHeight(start + a, z) : GetHeight(x, start + a);
+    const float hb = alongX ? GetHeight(start + b, z) : GetHeight(x, start + b);
+    return ha + (hb - ha) * t;
+  }
+
+  // edgeLods: -X, +X, -Z, +Z neighbour LOD (only used when coarser than the chunk)
+  void Terrain::BuildChunkMesh(Chunk& chunk, const int edgeLods[4]) {
+    ReleaseChunkMesh(chunk);
+
+    const int step = 1 << chunk.lod;
+    std::vector<int> xs, zs;
+    ChunkAxis(chunk.quadsX, step, xs);
+    ChunkAxis(chunk.quadsZ, step, zs);
+
+    const int vx = (int)xs.size();
+    const int vz = (int)zs.size();
+    Mesh mesh = { 0 };
+    mesh.vertexCount = vx * vz;
+    mesh.triangleCount = (vx - 1) * (vz - 1) * 2;
+    mesh.vertices = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.normals = (float*)MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.texcoords = (float*)MemAlloc(mesh.vertexCount * 2 * sizeof(float));
+    mesh.indices = (unsigned short*)MemAlloc(mesh.triangleCount * 3 * sizeof(unsigned short));
+
+    const float cell = m_Settings.cellSize;
+    int v = 0;
+    for (int j = 0; j < vz; ++j) {
+      for (int i = 0; i < vx; ++i, ++v) {
+	const int x = chunk.x0 + xs[i];
+	const int z = chunk.z0 + zs[j];
+
+	float h = GetHeight(x, z);
+	if (i == 0 && edgeLods[0] > chunk.lod)
+	  h = EdgeHeight(x, z, zs[j], chunk.z0, chunk.quadsZ, 1 << edgeLods[0], false);
+	else if (i == vx - 1 && edgeLods[1] > chunk.lod)
+	  h = EdgeHeight(x, z, zs[j], chunk.z0, chunk.quadsZ, 1 << edgeLods[1], false);
+	if (j == 0 && edgeLods[2] > chunk.lod)
+	  h = EdgeHeight(x, z, xs[i], chunk.x0, chunk.quadsX, 1 << edgeLods[2], true);
+	else if (j == vz - 1 && edgeLods[3] > chunk.lod)
+	  h = EdgeHeight(x, z, xs[i], chunk.x0, chunk.quadsX, 1 << edgeLods[3], true);
+
+	const Vector3 n = SampleNormal(x, z);
+	mesh.vertices[v * 3 + 0] = x * cell;
+	mesh.vertices[v * 3 + 1] = h;
+	mesh.vertices[v * 3 + 2] = z * cell;
+	mesh.normals[v * 3 + 0] = n.x;
+	mesh.normals[v * 3 + 1] = n.y;
+	mesh.normals[v * 3 + 2] = n.z;
+	mesh.texcoords[v * 2 + 0] = (float)x / (float)(m_Width - 1);
+	mesh.texcoords[v * 2 + 1] = (float)z / (float)(m_Length - 1);
+      }
+    }
+
+    // counter-clockwise seen from +Y
+    int k = 0;
+    for (int j = 0; j < vz - 1; ++j) {
+      for (int i = 0; i < vx - 1; ++i) {
+	const unsigned short i00 = (unsigned short)(j * vx + i);
+	const unsigned short i10 = (unsigned short)(i00 + 1);
+	const unsigned short i01 = (unsigned short)(i00 + vx);
+	const unsigned short i11 = (unsigned short)(i01 + 1);
+	mesh.indices[k++] = i00; mesh.indices[k++] = i01; mesh.indices[k++] = i10;
+	mesh.indices[k++] = i10; mesh.indices[k++] = i01; mesh.indices[k++] = i11;
+      }
+    }
+
+    UploadMesh(&mesh, false);
+    chunk.mesh = mesh;
+    chunk.hasMesh = true;
+  }
+
+  void Terrain::ReleaseChunkMesh(Chunk& chunk) {
+    if (!chunk.hasMesh) return;
+    UnloadMesh(chunk.mesh);
+    chunk.mesh = {};
+    chunk.hasMesh = false;
+    chunk.key = -1;
+  }
+
+  // --- Rendering -------------------------------------------------------------------
+  void Terrain::Draw(const Camera3D& camera, const Vector3& position, Color tint) {
+    m_DrawCalls = 0;
+    if (!IsLoaded()) return;
+
+    // LOD from the distance to the chunk bounds; -1 marks out of range
+    for (auto& chunk : m_Chunks) {
+      const Vector3 lo = Vector3Add(chunk.bounds.min, position);
+      const Vector3 hi = Vector3Add(chunk.bounds.max, position);
+      const Vector3 closest = { std::clamp(camera.position.x, lo.x, hi.x),
+				std::clamp(camera.position.y, lo.y, hi.y),
+				std::clamp(camera.position.z, lo.z, hi.z) };
+      const float dist = Vector3Distance(camera.position, closest);
+      if (dist > m_Settings.viewDistance) {
+	ReleaseChunkMesh(chunk);
+	chunk.lod = -1;
+	continue;
+      }
+
+      int lod = 0;
+      float range = m_Settings.lodDistance;
+      while (dist > range && lod < m_Settings.lodCount - 1) {
+	lod++;
+	range *= 2.0f;
+      }
+      chunk.lod = lod;
+    }
+
+    const float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
+    const Frustum frustum = GetCameraFrustum(camera, aspect);
+    const Matrix transform = MatrixTranslate(position.x, position.y, position.z);
+    m_Material.maps[MATERIAL_MAP_DIFFUSE].color = tint;
+
+    int budget = m_Settings.rebuildBudget;
+    for (int cz = 0; cz < m_ChunksZ; ++cz) {
+      for (int cx = 0; cx < m_ChunksX; ++cx) {
+	Chunk& chunk = m_Chunks[(size_t)cz * m_ChunksX + cx];
+	if (chunk.lod < 0) continue;
+
+	const BoundingBox box = { Vector3Add(chunk.bounds.min, position), Vector3Add(chunk.bounds.max, position) };
+	if (!FrustumIntersectsBox(frustum, box)) continue;
+
+	auto neighbourLod = [&](int nx, int nz) {
+	  if (nx < 0 || nz < 0 || nx >= m_ChunksX || nz >= m_ChunksZ) return chunk.lod;
+	  const int lod = m_Chunks[(size_t)nz * m_ChunksX + nx].lod;
+	  return lod < 0 ? chunk.lod : lod;
+	};
+	int edges[4] = { neighbourLod(cx - 1, cz), neighbourLod(cx + 1, cz),
+			 neighbourLod(cx, cz - 1), neighbourLod(cx, cz + 1) };
+	int key = chunk.lod;
+	for (int& e : edges) {
+	  e = std::max(e, chunk.lod);
+	  key = key * 8 + e;
+	}
+
+	// chunks without a mesh always build; stale ones wait for budget
+	if (key != chunk.key && (!chunk.hasMesh || budget > 0)) {
+	  if (chunk.hasMesh) budget--;
+	  BuildChunkMesh(chunk, edges);
+	  chunk.key = key;
+	}
+
+	DrawMesh(chunk.mesh, m_Material, transform);
+	m_DrawCalls++;
+      }
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#include "repch.h"
+#include "Core/ThreadPool.h"
+
+namespace RE {
+
+  ThreadPool::ThreadPool(uint32_t workers) {
+    m_Workers.reserve(workers);
+    for (uint32_t i = 0; i < workers; ++i)
+      m_Workers.emplace_back([this] { WorkerLoop(); });
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    for (auto& worker : m_Workers)
+      worker.join();
+  }
+
+  ThreadPool& ThreadPool::Get() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  uint32_t ThreadPool::DefaultWorkerCount() {
+    // leave the main thread its own core
+    const uint32_t hw = std::thread::hardware_concurrency();
+    return hw > 1 ? hw - 1 : 1;
+  }
+
+  void ThreadPool::Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Tasks.push_back(std::move(task));
+    }
+    m_Condition.notify_one();
+  }
+
+  void ThreadPool::WorkerLoop() {
+    for (;;) {
+      std::function<void()> task;
+      {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+	if (m_Stopping && m_Tasks.empty()) return;
+	task = std::move(m_Tasks.front());
+	m_Tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  void ThreadPool::ParallelFor(size_t count, size_t minBatch, const std::function<void(size_t, size_t)>& func) {
+    if (count == 0) return;
+    minBatch = std::max<size_t>(minBatch, 1);
+
+    const size_t maxBatches = (count + minBatch - 1) / minBatch;
+    const size_t batches = std::min<size_t>(maxBatches, (size_t)GetWorkerCount() + 1);
+    if (batches <= 1) {
+      func(0, count);
+      return;
+    }
+
+    // shared with helpers that may start after this call already returned
+    struct State {
+      std::atomic<size_t> next{ 0 };
+      std::atomic<size_t> done{ 0 };
+      size_t count = 0;
+      size_t batch = 0;
+      size_t batches = 0;
+      const std::function<void(size_t, size_t)>* func = nullptr;
+      std::mutex mutex;
+      std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->batches = batches;
+    state->batch = (count + batches - 1) / batches;
+    state->func = &func;
+
+    auto run = [](State& s) {
+      for (;;) {
+	const size_t index = s.next.fetch_add(1);
+	if (index >= s.batches) return;
+	const size_t begin = index * s.batch;
+	const size_t end = std::min(begin + s.batch, s.count);
+	if (begin < end) (*s.func)(begin, end);
+	if (s.done.fetch_add(1) + 1 == s.batches) {
+	  std::lock_guard<std::mutex> lock(s.mutex);
+	  s.finished.notify_all();
+	}
+      }
+    };
+
+    for (size_t i = 1; i < batches; ++i)
+      Submit([state, run] { run(*state); });
+
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done.load() == state->batches; });
+  }
+}
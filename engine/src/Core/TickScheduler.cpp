@@ -0,0 +1,126 @@
+#include "repch.h"
+#include "Core/TickScheduler.h"
+#include <chrono>
+
+namespace RE {
+
+  TickScheduler::TickScheduler() {
+    CreateGroup("EveryFrame", 0.0f);
+  }
+
+  TickScheduler::TickGroupID TickScheduler::CreateGroup(std::string_view name, float rateHz, float budgetMs) {
+    m_Groups.emplace_back();
+    m_Stats.emplace_back();
+    m_Stats.back().name = StringInterner::Intern(name);
+    const TickGroupID group = (TickGroupID)m_Groups.size() - 1;
+    SetGroupRate(group, rateHz);
+    SetGroupBudget(group, budgetMs);
+    return group;
+  }
+
+  void TickScheduler::SetGroupRate(TickGroupID group, float rateHz) {
+    if (group >= m_Groups.size()) {
+      TraceLog(LOG_ERROR, "SetGroupRate: unknown tick group %u", group);
+      return;
+    }
+    // clocks already set keep their next run; the new period applies after it
+    m_Groups[group].period = rateHz > 0.0f ? 1.0 / rateHz : 0.0;
+    m_Stats[group].rate = std::max(rateHz, 0.0f);
+  }
+
+  void TickScheduler::SetGroupBudget(TickGroupID group, float budgetMs) {
+    if (group >= m_Groups.size()) {
+      TraceLog(LOG_ERROR, "SetGroupBudget: unknown tick group %u", group);
+      return;
+    }
+    m_Groups[group].budgetMs = std::max(budgetMs, 0.0f);
+    m_Stats[group].budgetMs = m_Groups[group].budgetMs;
+  }
+
+  TickScheduler::TickID TickScheduler::Register(TickGroupID group, TickFn fn, float phase) {
+    if (group >= m_Groups.size()) {
+      TraceLog(LOG_ERROR, "Register: unknown tick group %u", group);
+      return 0;
+    }
+    Pending pending{ group, {}, phase };
+    pending.task.id = m_NextID++;
+    pending.task.fn = std::move(fn);
+    const TickID id = pending.task.id;
+
+    // a running task's std::function must not move under it
+    if (m_Ticking)
+      m_Pending.push_back(std::move(pending));
+    else
+      Add(std::move(pending));
+    return id;
+  }
+
+  void TickScheduler::Add(Pending pending) {
+    Group& group = m_Groups[pending.group];
+    float phase = pending.phase;
+    if (phase < 0.0f)
+      phase = TickClock::SpreadPhase(group.spread++);
+    pending.task.clock.Start(m_Time, group.period, std::min(phase, 1.0f));
+    group.tasks.push_back(std::move(pending.task));
+  }
+
+  void TickScheduler::Unregister(TickID id) {
+    for (auto& pending : m_Pending)
+      if (pending.task.id == id) pending.task.id = 0;
+    for (auto& group : m_Groups)
+      for (auto& task : group.tasks)
+	if (task.id == id) {
+	  // swept after the tick, the task may be the one running
+	  task.id = 0;
+	  return;
+	}
+  }
+
+  void TickScheduler::Tick(float dt) {
+    m_Time += dt;
+    m_Ticking = true;
+    for (size_t i = 0; i < m_Groups.size(); ++i)
+      RunGroup(i);
+    m_Ticking = false;
+
+    for (auto& group : m_Groups)
+      group.tasks.erase(std::remove_if(group.tasks.begin(), group.tasks.end(),
+				       [](const Task& task) { return task.id == 0; }),
+			group.tasks.end());
+    for (auto& pending : m_Pending)
+      if (pending.task.id != 0) Add(std::move(pending));
+    m_Pending.clear();
+  }
+
+  void TickScheduler::RunGroup(size_t index) {
+    using Clock = std::chrono::steady_clock;
+    // tasks may create groups, so m_Groups and m_Stats are indexed afresh
+    // after every call; a group's task storage itself does not move
+    m_Stats[index].usedMs = 0.0f;
+    m_Stats[index].ran = m_Stats[index].deferred = 0;
+
+    const auto& tasks = m_Groups[index].tasks;
+    m_Due.clear();
+    for (uint32_t i = 0; i < (uint32_t)tasks.size(); ++i)
+      if (tasks[i].id != 0 && tasks[i].clock.Due(m_Time))
+	m_Due.push_back({ tasks[i].clock.next, i });
+    if (m_Due.empty()) return;
+    // most overdue first, so deferred tasks get the next frame's budget
+    std::sort(m_Due.begin(), m_Due.end());
+
+    const auto start = Clock::now();
+    const size_t due = m_Due.size();
+    for (size_t n = 0; n < due; ++n) {
+      const float budgetMs = m_Groups[index].budgetMs;
+      if (n > 0 && budgetMs > 0.0f && m_Stats[index].usedMs >= budgetMs) {
+	m_Stats[index].deferred = (uint32_t)(due - n);
+	break;
+      }
+      Task& task = m_Groups[index].tasks[m_Due[n].second];
+      if (task.id != 0)
+	task.fn(task.clock.Advance(m_Time, m_Groups[index].period));
+      ++m_Stats[index].ran;
+      m_Stats[index].usedMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+  }
+}
@@ -1,18 +1,56 @@
 #include "Core/UUID.h"
 
 #include <random>
-
-#include <unordered_map>
+#include <thread>
 
 namespace RE {
 
-  static std::random_device s_RandomDevice;
-  static std::mt19937_64 s_Engine(s_RandomDevice());
-  static std::uniform_int_distribution<uint64_t> s_UniformDistribution;
+  namespace {
+
+    uint64_t SplitMix64(uint64_t& state) {
+      uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    // xoshiro256**, one per thread so UUID() needs no lock; seeded once from
+    // random_device and the thread id through SplitMix64
+    struct UUIDGenerator {
+      uint64_t s[4];
+
+      UUIDGenerator() {
+	std::random_device device;
+	uint64_t seed = ((uint64_t)device() << 32) ^ device();
+	seed ^= std::hash<std::thread::id>()(std::this_thread::get_id());
+	for (auto& word : s)
+	  word = SplitMix64(seed);
+      }
+
+      static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+      uint64_t Next() {
+	const uint64_t result = Rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = Rotl(s[3], 45);
+	return result;
+      }
+    };
+
+    thread_local UUIDGenerator t_Generator;
+  }
 
   UUID::UUID()
-    : m_UUID(s_UniformDistribution(s_Engine))
   {
+    // 0 is reserved for "no id" (EMPTY_ASSET)
+    do {
+      m_UUID = t_Generator.Next();
+    } while (m_UUID == 0);
   }
 
   UUID::UUID(uint64_t uuid)
@@ -20,4 +58,4 @@ namespace RE {
   {
   }
 
-}
\ No newline at end of file
+}
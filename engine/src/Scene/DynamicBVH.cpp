@@ -0,0 +1,303 @@
+#include "repch.h"
+#include "Scene/DynamicBVH.h"
+
+namespace RE {
+
+  static BoundingBox Union(const BoundingBox& a, const BoundingBox& b) {
+    return { { std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+	     { std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) } };
+  }
+
+  static float SurfaceArea(const BoundingBox& box) {
+    const float dx = box.max.x - box.min.x;
+    const float dy = box.max.y - box.min.y;
+    const float dz = box.max.z - box.min.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+  }
+
+  bool DynamicBVH::Update(entt::entity entity, const BoundingBox& box) {
+    const BoundingBox fat = { { box.min.x - m_Margin, box.min.y - m_Margin, box.min.z - m_Margin },
+			      { box.max.x + m_Margin, box.max.y + m_Margin, box.max.z + m_Margin } };
+
+    int32_t leaf = m_LeafOf.Find(Key(entity));
+    if (leaf == NullNode) {
+      leaf = AllocateNode();
+      Node& node = m_Nodes[leaf];
+      node.box = fat;
+      node.tight = box;
+      node.entity = entity;
+      node.slot = (uint32_t)m_Entities.size();
+      m_Entities.push_back(entity);
+      m_LeafOf.Insert(Key(entity), leaf);
+      InsertLeaf(leaf);
+      return true;
+    }
+
+    m_Nodes[leaf].tight = box;
+    if (Encloses(m_Nodes[leaf].box, box)) return false;
+
+    RemoveLeaf(leaf);
+    m_Nodes[leaf].box = fat;
+    InsertLeaf(leaf);
+    return true;
+  }
+
+  bool DynamicBVH::Remove(entt::entity entity) {
+    const int32_t leaf = m_LeafOf.Find(Key(entity));
+    if (leaf == NullNode) return false;
+
+    RemoveLeaf(leaf);
+    // swap-remove from the packed list
+    const uint32_t slot = m_Nodes[leaf].slot;
+    const entt::entity last = m_Entities.back();
+    m_Entities[slot] = last;
+    m_Nodes[m_LeafOf.Find(Key(last))].slot = slot;
+    m_Entities.pop_back();
+
+    m_LeafOf.Erase(Key(entity));
+    FreeNode(leaf);
+    return true;
+  }
+
+  void DynamicBVH::Clear() {
+    m_Nodes.clear();
+    m_Root = NullNode;
+    m_FreeList = NullNode;
+    m_Entities.clear();
+    m_LeafOf.Clear();
+  }
+
+  size_t DynamicBVH::QueryNearest(const Vector3& point, size_t k, std::vector<entt::entity>& out, float maxDistance) const {
+    out.clear();
+    if (m_Root == NullNode || k == 0) return 0;
+
+    // best first: nodes come off the queue in order of their box distance, so
+    // the search stops once the next node is further than the k-th hit
+    struct Item {
+      float distance;
+      int32_t node;
+      bool operator>(const Item& o) const { return distance > o.distance; }
+    };
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+    std::priority_queue<std::pair<float, entt::entity>> best; // max-heap of the k nearest
+
+    float limit = maxDistance < FLT_MAX ? maxDistance * maxDistance : FLT_MAX;
+    open.push({ DistanceSq(m_Nodes[m_Root].box, point), m_Root });
+    while (!open.empty()) {
+      const Item item = open.top();
+      open.pop();
+      if (item.distance > limit) break;
+
+      const Node& node = m_Nodes[item.node];
+      if (node.IsLeaf()) {
+	const float distance = DistanceSq(node.tight, point);
+	if (distance > limit) continue;
+	best.push({ distance, node.entity });
+	if (best.size() > k) best.pop();
+	if (best.size() == k) limit = best.top().first;
+	continue;
+      }
+      open.push({ DistanceSq(m_Nodes[node.child1].box, point), node.child1 });
+      open.push({ DistanceSq(m_Nodes[node.child2].box, point), node.child2 });
+    }
+
+    out.resize(best.size());
+    for (size_t i = out.size(); i-- > 0; best.pop())
+      out[i] = best.top().second;
+    return out.size();
+  }
+
+  int32_t DynamicBVH::AllocateNode() {
+    int32_t index;
+    if (m_FreeList != NullNode) {
+      index = m_FreeList;
+      m_FreeList = m_Nodes[index].parent;
+      m_Nodes[index] = Node{};
+    } else {
+      index = (int32_t)m_Nodes.size();
+      m_Nodes.emplace_back();
+    }
+    return index;
+  }
+
+  void DynamicBVH::FreeNode(int32_t node) {
+    m_Nodes[node].parent = m_FreeList;
+    m_Nodes[node].height = -1;
+    m_FreeList = node;
+  }
+
+  void DynamicBVH::InsertLeaf(int32_t leaf) {
+    if (m_Root == NullNode) {
+      m_Root = leaf;
+      m_Nodes[leaf].parent = NullNode;
+      return;
+    }
+
+    // descend towards the sibling with the lowest surface area cost
+    const BoundingBox leafBox = m_Nodes[leaf].box;
+    int32_t index = m_Root;
+    while (!m_Nodes[index].IsLeaf()) {
+      const Node& node = m_Nodes[index];
+      const float area = SurfaceArea(node.box);
+      const float combined = SurfaceArea(Union(node.box, leafBox));
+
+      // pairing with this node, or pushing the leaf further down
+      const float cost = 2.0f * combined;
+      const float inheritance = 2.0f * (combined - area);
+
+      auto childCost = [&](int32_t child) {
+	const Node& c = m_Nodes[child];
+	const float enlarged = SurfaceArea(Union(c.box, leafBox));
+	return (c.IsLeaf() ? enlarged : enlarged - SurfaceArea(c.box)) + inheritance;
+      };
+      const float cost1 = childCost(node.child1);
+      const float cost2 = childCost(node.child2);
+
+      if (cost < cost1 && cost < cost2) break;
+      index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+    const int32_t sibling = index;
+
+    const int32_t oldParent = m_Nodes[sibling].parent;
+    const int32_t newParent = AllocateNode();
+    Node& parent = m_Nodes[newParent];
+    parent.parent = oldParent;
+    parent.box = Union(leafBox, m_Nodes[sibling].box);
+    parent.height = m_Nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    m_Nodes[sibling].parent = newParent;
+    m_Nodes[leaf].parent = newParent;
+
+    if (oldParent == NullNode)
+      m_Root = newParent;
+    else if (m_Nodes[oldParent].child1 == sibling)
+      m_Nodes[oldParent].child1 = newParent;
+    else
+      m_Nodes[oldParent].child2 = newParent;
+
+    // refit and rebalance up to the root
+    for (index = m_Nodes[leaf].parent; index != NullNode; index = m_Nodes[index].parent) {
+      index = Balance(index);
+      Node& node = m_Nodes[index];
+      node.height = 1 + std::max(m_Nodes[node.child1].height, m_Nodes[node.child2].height);
+      node.box = Union(m_Nodes[node.child1].box, m_Nodes[node.child2].box);
+    }
+  }
+
+  void DynamicBVH::RemoveLeaf(int32_t leaf) {
+    if (leaf == m_Root) {
+      m_Root = NullNode;
+      return;
+    }
+
+    const int32_t parent = m_Nodes[leaf].parent;
+    const int32_t grandParent = m_Nodes[parent].parent;
+    const int32_t sibling = m_Nodes[parent].child1 == leaf ? m_Nodes[parent].child2 : m_Nodes[parent].child1;
+
+    FreeNode(parent);
+    m_Nodes[sibling].parent = grandParent;
+    if (grandParent == NullNode) {
+      m_Root = sibling;
+      return;
+    }
+
+    if (m_Nodes[grandParent].child1 == parent)
+      m_Nodes[grandParent].child1 = sibling;
+    else
+      m_Nodes[grandParent].child2 = sibling;
+
+    for (int32_t index = grandParent; index != NullNode; index = m_Nodes[index].parent) {
+      index = Balance(index);
+      Node& node = m_Nodes[index];
+      node.height = 1 + std::max(m_Nodes[node.child1].height, m_Nodes[node.child2].height);
+      node.box = Union(m_Nodes[node.child1].box, m_Nodes[node.child2].box);
+    }
+  }
+
+  // One rotation at `iA` if its children's heights differ by more than one.
+  // Returns the node now at A's place.
+  int32_t DynamicBVH::Balance(int32_t iA) {
+    Node& A = m_Nodes[iA];
+    if (A.IsLeaf() || A.height < 2) return iA;
+
+    const int32_t iB = A.child1;
+    const int32_t iC = A.child2;
+    Node& B = m_Nodes[iB];
+    Node& C = m_Nodes[iC];
+    const int32_t balance = C.height - B.height;
+
+    // hook the promoted node where A was
+    auto replaceA = [&](int32_t promoted) {
+      Node& P = m_Nodes[promoted];
+      P.parent = A.parent;
+      A.parent = promoted;
+      if (P.parent == NullNode)
+	m_Root = promoted;
+      else if (m_Nodes[P.parent].child1 == iA)
+	m_Nodes[P.parent].child1 = promoted;
+      else
+	m_Nodes[P.parent].child2 = promoted;
+    };
+
+    if (balance > 1) {
+      // C goes up; its taller child stays with it
+      const int32_t iF = C.child1;
+      const int32_t iG = C.child2;
+      Node& F = m_Nodes[iF];
+      Node& G = m_Nodes[iG];
+      C.child1 = iA;
+      replaceA(iC);
+
+      if (F.height > G.height) {
+	C.child2 = iF;
+	A.child2 = iG;
+	G.parent = iA;
+	A.box = Union(B.box, G.box);
+	C.box = Union(A.box, F.box);
+	A.height = 1 + std::max(B.height, G.height);
+	C.height = 1 + std::max(A.height, F.height);
+      } else {
+	C.child2 = iG;
+	A.child2 = iF;
+	F.parent = iA;
+	A.box = Union(B.box, F.box);
+	C.box = Union(A.box, G.box);
+	A.height = 1 + std::max(B.height, F.height);
+	C.height = 1 + std::max(A.height, G.height);
+      }
+      return iC;
+    }
+
+    if (balance < -1) {
+      // B goes up
+      const int32_t iD = B.child1;
+      const int32_t iE = B.child2;
+      Node& D = m_Nodes[iD];
+      Node& E = m_Nodes[iE];
+      B.child1 = iA;
+      replaceA(iB);
+
+      if (D.height > E.height) {
+	B.child2 = iD;
+	A.child1 = iE;
+	E.parent = iA;
+	A.box = Union(C.box, E.box);
+	B.box = Union(A.box, D.box);
+	A.height = 1 + std::max(C.height, E.height);
+	B.height = 1 + std::max(A.height, D.height);
+      } else {
+	B.child2 = iE;
+	A.child1 = iD;
+	D.parent = iA;
+	A.box = Union(C.box, D.box);
+	B.box = Union(A.box, E.box);
+	A.height = 1 + std::max(C.height, D.height);
+	B.height = 1 + std::max(A.height, E.height);
+      }
+      return iB;
+    }
+
+    return iA;
+  }
+}
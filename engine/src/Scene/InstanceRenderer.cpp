@@ -0,0 +1,86 @@
+#include "repch.h"
+#include "Scene/InstanceRenderer.h"
+#include "Auxiliaries/Assets.h"
+#include "Core/Application.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+namespace RE {
+
+  // fixed id: every scene shares the one the AssetRegistry holds and unloads
+  static constexpr AssetID INSTANCING_SHADER = 0x5E1A57A4CED0001ull;
+
+  // Looked up (or loaded) on first use. False if the shader is unavailable and
+  // everything is drawn the old way.
+  bool InstanceRenderer::AcquireShader(){
+    if (m_ShaderTried) return m_Shader != nullptr;
+    m_ShaderTried = true;
+
+    AssetRegistry& assets = Application::Get().GetAssets();
+    auto& shaders = assets.GetMap<ShaderAsset>();
+    auto it = shaders.find(INSTANCING_SHADER);
+    Ref<ShaderAsset> shader = it != shaders.end()
+      ? std::static_pointer_cast<ShaderAsset>(it->second)
+      : assets.AddShader(INSTANCING_SHADER, "Data/Shaders/instanced.vs", "Data/Shaders/instanced.fs");
+    if (shader->Data.id == 0 || shader->Data.id == rlGetShaderIdDefault()) {
+      TraceLog(LOG_WARNING, "Instancing shader unavailable, models are drawn one by one");
+      return false;
+    }
+    shader->Data.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(shader->Data, "instanceTransform");
+    m_Shader = shader;
+    return true;
+  }
+
+  bool InstanceRenderer::Instanceable(const ModelAsset& asset){
+    const Model& model = asset.Data;
+    if (model.meshCount == 0 || model.boneCount > 0) return false;
+    for (int i = 0; i < model.meshCount; ++i)
+      if (model.materials[model.meshMaterial[i]].shader.id != rlGetShaderIdDefault())
+	return false;
+    return true;
+  }
+
+  void InstanceRenderer::Begin(){
+    for (size_t i = 0; i < m_Used; ++i)
+      m_Batches[i].instances.clear();
+    m_Used = 0;
+    m_BatchIndex.clear();
+  }
+
+  bool InstanceRenderer::Add(const ModelAsset& asset, const Matrix& world, Color tint){
+    auto [it, inserted] = m_BatchIndex.try_emplace(&asset, Refused);
+    if (inserted && AcquireShader() && Instanceable(asset)) {
+      if (m_Used == m_Batches.size()) m_Batches.emplace_back();
+      m_Batches[m_Used].asset = &asset;
+      it->second = (uint32_t)m_Used++;
+    }
+    if (it->second == Refused) return false;
+
+    Matrix instance = MatrixMultiply(asset.Data.transform, world);
+    instance.m3 = tint.r / 255.0f;
+    instance.m7 = tint.g / 255.0f;
+    instance.m11 = tint.b / 255.0f;
+    instance.m15 = tint.a / 255.0f;
+    m_Batches[it->second].instances.push_back(instance);
+    return true;
+  }
+
+  void InstanceRenderer::Flush(){
+    m_DrawCalls = m_InstanceCount = 0;
+    if (m_Used == 0) return;
+    const Shader& shader = m_Shader->Data;
+    for (size_t b = 0; b < m_Used; ++b) {
+      const Batch& batch = m_Batches[b];
+      const Model& model = batch.asset->Data;
+      const int count = (int)batch.instances.size();
+      for (int i = 0; i < model.meshCount; ++i) {
+	// the mesh's own maps and colors, our shader
+	Material material = model.materials[model.meshMaterial[i]];
+	material.shader = shader;
+	DrawMeshInstanced(model.meshes[i], material, batch.instances.data(), count);
+	++m_DrawCalls;
+      }
+      m_InstanceCount += count;
+    }
+  }
+}
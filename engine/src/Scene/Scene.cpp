@@ -5,13 +5,36 @@
 #include "Scene/Scene.h"
 #include "Scene/Components.h"
 #include "Scene/Entity.h"
+#include "Scene/CommandBuffer.h"
+#include "Scene/Prefab.h"
+#include "Scene/WorldPartition.h"
+#include "Scene/NativeScript.h"
 #include "Auxiliaries/rayext.h"
 #include "Core/Application.h"
 #include "Core/UUID.h"
+#include <cstring>
 
 namespace RE {
 
-  Scene::Scene(){
+  // Hot component pairs kept in entt groups. entt only lets a type be owned by
+  // nested groups, so Transform is owned by the physics group alone and the
+  // render groups own their draw component and fetch Transform.
+  static auto PhysicsGroup(entt::registry& registry) {
+    return registry.group<RigidbodyComponent, TransformComponent>();
+  }
+
+  static auto ModelGroup(entt::registry& registry) {
+    return registry.group<ModelComponent>(entt::get<TransformComponent>);
+  }
+
+  static auto CubeGroup(entt::registry& registry) {
+    return registry.group<CubeComponent>(entt::get<TransformComponent>);
+  }
+
+  Scene::Scene()
+    : Scene(true) {}
+
+  Scene::Scene(bool setupRegistry){
     m_EditorCam.position = { 10.0f, 10.0f, 10.0f }; // Camera position
     m_EditorCam.target = { 0.0f, 0.0f, 0.0f };      // Camera looking at point
     m_EditorCam.up = { 0.0f, 1.0f, 0.0f };          // Camera up vector (rotation towards target)
@@ -19,29 +42,742 @@ namespace RE {
     m_EditorCam.projection = CAMERA_PERSPECTIVE; // Camera projection type
 
     m_Physics3D.Init();
+    m_Physics3D.Stop(); // bodies exist from OnRuntimeStart to OnRuntimeStop
+
+    // declared up front so the pools stay packed from the first emplace
+    if (setupRegistry)
+      SetupRegistry();
 
     testPos = {0, 3, 0};
   }
 
   Scene::~Scene(){}
 
-  Entity Scene::CreateEntity(const std::string& name)
+  void Scene::SetupRegistry(){
+    PhysicsGroup(m_Registry);
+    ModelGroup(m_Registry);
+    CubeGroup(m_Registry);
+
+    // the UUID index follows IDComponent whichever way it is added or removed
+    m_Registry.on_construct<IDComponent>().connect<&Scene::OnIDConstruct>(this);
+    m_Registry.on_update<IDComponent>().connect<&Scene::OnIDUpdate>(this);
+    m_Registry.on_destroy<IDComponent>().connect<&Scene::OnIDDestroy>(this);
+    m_Registry.on_construct<TagComponent>().connect<&Scene::OnTagConstruct>(this);
+    m_Registry.on_update<TagComponent>().connect<&Scene::OnTagUpdate>(this);
+    m_Registry.on_destroy<TagComponent>().connect<&Scene::OnTagDestroy>(this);
+
+    // the spatial index revisits entities whose drawables come or go
+    m_Registry.on_construct<TransformComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_destroy<TransformComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_construct<CubeComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_destroy<CubeComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_construct<SphereComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_destroy<SphereComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_construct<PlaneComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_destroy<PlaneComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_construct<ModelComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_update<ModelComponent>().connect<&Scene::OnDrawableChanged>(this);
+    m_Registry.on_destroy<ModelComponent>().connect<&Scene::OnDrawableChanged>(this);
+
+    // bodies leave the world with their component, however it goes away
+    m_Registry.on_destroy<RigidbodyComponent>().connect<&Scene::OnRigidbodyDestroy>(this);
+    m_Registry.on_destroy<TriggerComponent>().connect<&Scene::OnTriggerDestroy>(this);
+    m_Registry.on_destroy<TerrainComponent>().connect<&Scene::OnTerrainDestroy>(this);
+    // baked scenery whose model or flag changes is drawn on its own again
+    m_Registry.on_update<ModelComponent>().connect<&Scene::OnStaticChanged>(this);
+    m_Registry.on_destroy<ModelComponent>().connect<&Scene::OnStaticChanged>(this);
+    m_Registry.on_update<StaticComponent>().connect<&Scene::OnStaticChanged>(this);
+    m_Registry.on_destroy<StaticComponent>().connect<&Scene::OnStaticChanged>(this);
+    m_Registry.on_construct<NativeScriptComponent>().connect<&Scene::OnScriptConstruct>(this);
+    m_Registry.on_update<NativeScriptComponent>().connect<&Scene::OnScriptReplace>(this);
+    m_Registry.on_destroy<NativeScriptComponent>().connect<&Scene::OnScriptDestroy>(this);
+  }
+
+  void Scene::OnIDConstruct(entt::registry& registry, entt::entity entity){
+    const uint64_t id = registry.get<IDComponent>(entity).ID;
+    const size_t index = entt::to_entity(entity);
+    if (index >= m_IndexedIDs.size()) m_IndexedIDs.resize(index + 1, 0);
+    m_IndexedIDs[index] = id;
+    m_EntityIndex.Insert(id, entity);
+  }
+
+  // a replaced or patched id: re-key from the one the index holds
+  void Scene::OnIDUpdate(entt::registry& registry, entt::entity entity){
+    if (m_IndexedIDs[entt::to_entity(entity)] == registry.get<IDComponent>(entity).ID) return;
+    OnIDDestroy(registry, entity);
+    OnIDConstruct(registry, entity);
+  }
+
+  void Scene::OnIDDestroy(entt::registry& registry, entt::entity entity){
+    const uint64_t id = m_IndexedIDs[entt::to_entity(entity)];
+    // a duplicate id may have taken the slot over since
+    if (m_EntityIndex.Find(id) == entity)
+      m_EntityIndex.Erase(id);
+  }
+
+  Entity Scene::GetEntityByUUID(UUID uuid){
+    const entt::entity entity = m_EntityIndex.Find(uuid);
+    // an ID written in place (no patch) is not found
+    if (entity == entt::null || !m_Registry.valid(entity) ||
+	m_Registry.get<IDComponent>(entity).ID != uuid)
+      return {};
+    return { entity, this };
+  }
+
+  void Scene::ResolveUUIDs(const uint64_t* uuids, size_t count, entt::entity* out) const{
+    m_EntityIndex.FindMany(uuids, count, out);
+  }
+
+  void Scene::OnTagConstruct(entt::registry& registry, entt::entity entity){
+    IndexName(registry.get<TagComponent>(entity).Tag, entity);
+  }
+
+  // a replaced or patched tag: the old name is the one the index holds
+  void Scene::OnTagUpdate(entt::registry& registry, entt::entity entity){
+    const StringID name = registry.get<TagComponent>(entity).Tag;
+    const StringID old = m_IndexedNames[entt::to_entity(entity)];
+    if (name == old) return;
+    UnindexName(old, entity);
+    IndexName(name, entity);
+  }
+
+  void Scene::OnTagDestroy(entt::registry& registry, entt::entity entity){
+    UnindexName(m_IndexedNames[entt::to_entity(entity)], entity);
+  }
+
+  void Scene::IndexName(StringID name, entt::entity entity){
+    const size_t index = entt::to_entity(entity);
+    if (index >= m_IndexedNames.size()) m_IndexedNames.resize(index + 1, 0);
+    m_IndexedNames[index] = name;
+
+    NameEntry entry = m_NameIndex.Find(name);
+    if (entry.entity == entt::null) entry.entity = entity;
+    ++entry.count;
+    m_NameIndex.Insert(name, entry);
+  }
+
+  void Scene::UnindexName(StringID name, entt::entity entity){
+    NameEntry entry = m_NameIndex.Find(name);
+    if (entry.count <= 1) {
+      m_NameIndex.Erase(name);
+      return;
+    }
+    // others keep the name; FindByName picks a new one when asked
+    --entry.count;
+    if (entry.entity == entity) entry.entity = entt::null;
+    m_NameIndex.Insert(name, entry);
+  }
+
+  Entity Scene::FindByName(std::string_view name){
+    return FindByName(HashString(name));
+  }
+
+  Entity Scene::FindByName(StringID name){
+    NameEntry entry = m_NameIndex.Find(name);
+    if (entry.count == 0) return {};
+    if (entry.entity != entt::null && m_Registry.valid(entry.entity) &&
+	m_Registry.get<TagComponent>(entry.entity).Tag == name)
+      return { entry.entity, this };
+
+    // the indexed holder went away: scan once for another and remember it
+    for (auto [entity, tag] : m_Registry.view<TagComponent>().each()) {
+      if (tag.Tag != name) continue;
+      entry.entity = entity;
+      m_NameIndex.Insert(name, entry);
+      return { entity, this };
+    }
+    return {};
+  }
+
+  void Scene::OnDrawableChanged(entt::registry& registry, entt::entity entity){
+    m_SpatialPending.push_back(entity);
+  }
+
+  // Destroy hooks only queue the handle: a batch destroy fires them once per
+  // entity, and FlushReleases hands the whole batch to Physics3D in one call.
+  void Scene::OnRigidbodyDestroy(entt::registry& registry, entt::entity entity){
+    if (void* body = registry.get<RigidbodyComponent>(entity).body)
+      m_BodyReleases.push_back(body);
+  }
+
+  void Scene::OnTriggerDestroy(entt::registry& registry, entt::entity entity){
+    if (void* ghost = registry.get<TriggerComponent>(entity).ghost)
+      m_TriggerReleases.push_back(ghost);
+  }
+
+  void Scene::OnTerrainDestroy(entt::registry& registry, entt::entity entity){
+    if (void* body = registry.get<TerrainComponent>(entity).body)
+      m_BodyReleases.push_back(body);
+  }
+
+  void Scene::OnStaticChanged(entt::registry& registry, entt::entity entity){
+    m_StaticGeometry.Remove(entity);
+  }
+
+  // Scripts bound while running are created together by the next UpdateScripts,
+  // never in the middle of a pool's update loop.
+  void Scene::OnScriptConstruct(entt::registry& registry, entt::entity entity){
+    if (m_ScriptsRunning)
+      m_ScriptCreates.push_back(entity);
+  }
+
+  // A patch that binds another type keeps the old slot, a replace arrives
+  // without one; either way the old script goes first and the new one is queued.
+  void Scene::OnScriptReplace(entt::registry& registry, entt::entity entity){
+    if (!m_ScriptsRunning) return;
+    auto& comp = registry.get<NativeScriptComponent>(entity);
+    if (comp.slot != NativeScriptComponent::NullSlot) {
+      if (comp.type == comp.runningType) return;
+      if (ScriptPoolBase* pool = FindScriptPool(comp.runningType))
+	pool->Destroy(comp.slot);
+      comp.slot = NativeScriptComponent::NullSlot;
+    } else {
+      for (auto& pool : m_ScriptPools) {
+	const uint32_t slot = pool->Find(entity);
+	if (slot != NativeScriptComponent::NullSlot) pool->Destroy(slot);
+      }
+    }
+    m_ScriptCreates.push_back(entity);
+  }
+
+  void Scene::OnScriptDestroy(entt::registry& registry, entt::entity entity){
+    auto& comp = registry.get<NativeScriptComponent>(entity);
+    if (comp.slot == NativeScriptComponent::NullSlot) return;
+    if (ScriptPoolBase* pool = FindScriptPool(comp.runningType))
+      pool->Destroy(comp.slot);
+    comp.slot = NativeScriptComponent::NullSlot;
+  }
+
+  ScriptPoolBase* Scene::FindScriptPool(entt::id_type type) const{
+    auto it = m_ScriptPoolIndex.find(type);
+    return it != m_ScriptPoolIndex.end() ? m_ScriptPools[it->second].get() : nullptr;
+  }
+
+  ScriptableEntity* Scene::GetScript(entt::entity entity, entt::id_type type){
+    const auto* comp = m_Registry.valid(entity) ? m_Registry.try_get<NativeScriptComponent>(entity) : nullptr;
+    if (!comp || comp->runningType != type || comp->slot == NativeScriptComponent::NullSlot) return nullptr;
+    ScriptPoolBase* pool = FindScriptPool(type);
+    return pool ? pool->Get(comp->slot) : nullptr;
+  }
+
+  // Instances go into their type's pool first and OnCreate runs afterwards,
+  // pool by pool. Scripts bound from OnCreate make another round.
+  void Scene::CreatePendingScripts(){
+    while (!m_ScriptCreates.empty()) {
+      m_ScriptBatch.swap(m_ScriptCreates);
+      for (entt::entity entity : m_ScriptBatch) {
+	if (!m_Registry.valid(entity)) continue;
+	auto* comp = m_Registry.try_get<NativeScriptComponent>(entity);
+	if (!comp || !comp->CreatePool || comp->slot != NativeScriptComponent::NullSlot) continue;
+
+	ScriptPoolBase* pool = FindScriptPool(comp->type);
+	if (!pool) {
+	  m_ScriptPoolIndex[comp->type] = (uint32_t)m_ScriptPools.size();
+	  pool = m_ScriptPools.emplace_back(comp->CreatePool()).get();
+	}
+	comp->slot = pool->Add(Entity(entity, this));
+	comp->runningType = comp->type;
+      }
+      m_ScriptBatch.clear();
+      for (auto& pool : m_ScriptPools)
+	pool->Start();
+    }
+  }
+
+  void Scene::UpdateScripts(float dt){
+    for (auto& pool : m_ScriptPools)
+      pool->Compact(m_Registry);
+    CreatePendingScripts();
+    for (size_t i = 0; i < m_ScriptPools.size(); ++i)
+      m_ScriptPools[i]->Update(dt);
+  }
+
+  void Scene::StopScripts(){
+    m_ScriptsRunning = false;
+    m_ScriptCreates.clear();
+    for (auto& pool : m_ScriptPools)
+      pool->Clear();
+    m_ScriptPools.clear();
+    m_ScriptPoolIndex.clear();
+    Each<NativeScriptComponent>([](auto &comp) {
+      comp.slot = NativeScriptComponent::NullSlot;
+    });
+  }
+
+  void Scene::NextChangeFrame(){
+    for (auto& [type, tracker] : m_ChangeTrackers)
+      tracker->NextFrame();
+  }
+
+  void Scene::FlushReleases(){
+    if (!m_BodyReleases.empty()) {
+      m_Physics3D.RemoveRigidBodies(m_BodyReleases.data(), m_BodyReleases.size());
+      m_BodyReleases.clear();
+    }
+    if (!m_TriggerReleases.empty()) {
+      m_Physics3D.RemoveTriggers(m_TriggerReleases.data(), m_TriggerReleases.size());
+      m_TriggerReleases.clear();
+    }
+  }
+
+  // the matrix DrawModelEx builds (rotation axis Rotation, one degree)
+  static Matrix ModelMatrix(const TransformComponent& transform){
+    const Vector3 s = transform.Scale;
+    const Vector3 t = transform.Translation;
+    return MatrixMultiply(MatrixMultiply(MatrixScale(s.x, s.y, s.z), MatrixRotate(transform.Rotation, DEG2RAD)),
+			  MatrixTranslate(t.x, t.y, t.z));
+  }
+
+  // World bounds of what the draw loops render for `entity`, matching their
+  // conventions: unit-radius spheres, Scale sized cubes and planes, models
+  // through DrawModelEx's matrix. False if nothing is drawn.
+  static bool DrawBounds(const entt::registry& registry, const TransformPool& transforms,
+			 entt::entity entity, BoundingBox& box){
+    const auto* transform = registry.try_get<TransformComponent>(entity);
+    if (!transform) return false;
+    const Vector3 t = transform->Translation;
+    const Vector3 s = transform->Scale;
+
+    bool drawn = false;
+    auto merge = [&box, &drawn](const Vector3& min, const Vector3& max) {
+      box = drawn ? BoundingBox{ Vector3Min(box.min, min), Vector3Max(box.max, max) } : BoundingBox{ min, max };
+      drawn = true;
+    };
+
+    if (registry.all_of<CubeComponent>(entity)) {
+      const Vector3 half = Vector3Scale(Vector3{ fabsf(s.x), fabsf(s.y), fabsf(s.z) }, 0.5f);
+      merge(Vector3Subtract(t, half), Vector3Add(t, half));
+    }
+    if (registry.all_of<SphereComponent>(entity))
+      merge(Vector3Subtract(t, { 1, 1, 1 }), Vector3Add(t, { 1, 1, 1 }));
+    if (registry.all_of<PlaneComponent>(entity)) {
+      const Vector3 half = { fabsf(s.x) * 0.5f, 0.0f, fabsf(s.y) * 0.5f };
+      merge(Vector3Subtract(t, half), Vector3Add(t, half));
+    }
+    if (const auto* model = registry.try_get<ModelComponent>(entity)) {
+      BoundingBox local = model->box;
+      if (local.max.x <= local.min.x && model->model)
+	local = model->model->Bounds;
+
+      // transformed box (Arvo): per axis, add the smaller and larger product
+      const Matrix* world = transforms.Find(entity);
+      const Matrix m = world ? *world : ModelMatrix(*transform);
+      const float rows[3][4] = { { m.m0, m.m4, m.m8, m.m12 }, { m.m1, m.m5, m.m9, m.m13 }, { m.m2, m.m6, m.m10, m.m14 } };
+      const float lo[3] = { local.min.x, local.min.y, local.min.z };
+      const float hi[3] = { local.max.x, local.max.y, local.max.z };
+      float min[3], max[3];
+      for (int i = 0; i < 3; ++i) {
+	min[i] = max[i] = rows[i][3];
+	for (int j = 0; j < 3; ++j) {
+	  const float a = rows[i][j] * lo[j];
+	  const float b = rows[i][j] * hi[j];
+	  min[i] += std::min(a, b);
+	  max[i] += std::max(a, b);
+	}
+      }
+      merge({ min[0], min[1], min[2] }, { max[0], max[1], max[2] });
+    }
+    return drawn;
+  }
+
+  void Scene::UpdateSpatialIndex(){
+    const entt::registry& registry = m_Registry;
+    BoundingBox box;
+    for (auto entity : m_SpatialPending) {
+      if (registry.valid(entity) && DrawBounds(registry, m_Transforms, entity, box))
+	m_SpatialIndex.Update(entity, box);
+      else
+	m_SpatialIndex.Remove(entity);
+    }
+    m_SpatialPending.clear();
+
+    // Refit: bounds are recomputed in parallel and only the ones that changed
+    // are written back; those still inside their fattened box leave the tree alone.
+    // With TransformComponent tracked only the transforms written since the last
+    // refit (last frame's set and this frame's so far) are revisited.
+    const std::vector<entt::entity>* refit = &m_SpatialIndex.GetEntities();
+    if (const ChangeTracker* tracker = FindTracker<TransformComponent>()) {
+      const ChangeSet& previous = tracker->GetChanges();
+      m_SpatialRefit.clear();
+      for (auto entity : previous.GetEntities())
+	if (m_SpatialIndex.Contains(entity)) m_SpatialRefit.push_back(entity);
+      for (auto entity : tracker->GetPending().GetEntities())
+	if (!previous.Get(entity) && m_SpatialIndex.Contains(entity)) m_SpatialRefit.push_back(entity);
+      refit = &m_SpatialRefit;
+    }
+    const auto& entities = *refit;
+    m_SpatialBounds.resize(entities.size());
+    m_SpatialMoved.assign(entities.size(), 0);
+    ThreadPool::Get().ParallelFor(entities.size(), 1024, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+	if (!DrawBounds(registry, m_Transforms, entities[i], m_SpatialBounds[i])) continue;
+	m_SpatialMoved[i] = memcmp(&m_SpatialBounds[i], &m_SpatialIndex.GetBounds(entities[i]), sizeof(BoundingBox)) != 0;
+      }
+    });
+    for (size_t i = 0; i < entities.size(); ++i)
+      if (m_SpatialMoved[i])
+	m_SpatialIndex.Update(entities[i], m_SpatialBounds[i]);
+  }
+
+  // DrawModelEx with the world matrix already built
+  static void DrawModelWorld(Model model, const Matrix& world, Color tint){
+    const Matrix transform = MatrixMultiply(model.transform, world);
+    for (int i = 0; i < model.meshCount; ++i) {
+      Material& material = model.materials[model.meshMaterial[i]];
+      const Color color = material.maps[MATERIAL_MAP_DIFFUSE].color;
+      material.maps[MATERIAL_MAP_DIFFUSE].color = {
+	(unsigned char)((int)color.r * tint.r / 255), (unsigned char)((int)color.g * tint.g / 255),
+	(unsigned char)((int)color.b * tint.b / 255), (unsigned char)((int)color.a * tint.a / 255) };
+      DrawMesh(model.meshes[i], material, transform);
+      material.maps[MATERIAL_MAP_DIFFUSE].color = color;
+    }
+  }
+
+  void Scene::DrawVisible(const Camera3D& camera){
+    const float aspect = (float)GetScreenWidth() / (float)GetScreenHeight();
+    const Frustum frustum = GetCameraFrustum(camera, aspect);
+    m_Visible.clear();
+    m_SpatialIndex.QueryFrustum(frustum, [this](entt::entity entity) {
+      m_Visible.push_back(entity);
+    });
+    // ascending ids walk the sparse arrays in order
+    std::sort(m_Visible.begin(), m_Visible.end());
+
+    m_Instances.Begin();
+    for (auto entity : m_Visible) {
+      const auto& transform = m_Registry.get<TransformComponent>(entity);
+      if (const auto* comp = m_Registry.try_get<CubeComponent>(entity))
+	DrawCube(transform.Translation, transform.Scale.x, transform.Scale.y, transform.Scale.z, comp->color);
+      if (const auto* comp = m_Registry.try_get<SphereComponent>(entity))
+	DrawSphere(transform.Translation, 1.0f, comp->color);
+      if (const auto* comp = m_Registry.try_get<PlaneComponent>(entity))
+	DrawPlane(transform.Translation, {transform.Scale.x, transform.Scale.y}, comp->color);
+      if (const auto* comp = m_Registry.try_get<ModelComponent>(entity);
+	  comp && comp->model && !m_StaticGeometry.IsBaked(entity)) {
+	const Matrix* world = m_Transforms.Find(entity);
+	if (!world)
+	  DrawModelEx(comp->model->Data, transform.Translation, transform.Rotation,
+		      1.0f, transform.Scale, comp->color);
+	else if (!m_Instances.Add(*comp->model, *world, comp->color))
+	  DrawModelWorld(comp->model->Data, *world, comp->color);
+      }
+    }
+    // one instanced draw per mesh of every shared asset
+    m_Instances.Flush();
+    m_StaticGeometry.Draw(frustum);
+  }
+
+  void Scene::BakeStaticGeometry(float cellSize){
+    // the pool may not have seen this scene yet (a fresh Copy)
+    m_Transforms.Update(m_Registry);
+    m_StaticGeometry.Bake(m_Registry, m_Transforms, cellSize);
+  }
+
+  Entity Scene::Raycast(const Ray& ray, float maxDistance, float* distance){
+    entt::entity hit = entt::null;
+    float nearest = maxDistance;
+    m_SpatialIndex.RayCast(ray, maxDistance, [&](entt::entity entity, float t) {
+      if (!m_Registry.valid(entity)) return nearest;
+
+      // lone models are refined against their triangles; the rest hit their bounds
+      const auto* model = m_Registry.try_get<ModelComponent>(entity);
+      if (model && model->model && model->model->BVH &&
+	  !m_Registry.any_of<CubeComponent, SphereComponent, PlaneComponent>(entity)) {
+	const Matrix* world = m_Transforms.Find(entity);
+	const Matrix transform = MatrixMultiply(model->model->Data.transform,
+						world ? *world : ModelMatrix(m_Registry.get<TransformComponent>(entity)));
+	MeshHit meshHit;
+	if (!model->model->BVH->RayCast(ray, transform, nearest, meshHit)) return nearest;
+	t = meshHit.distance;
+      }
+      hit = entity;
+      nearest = t;
+      return t;
+    });
+    if (hit == entt::null) return {};
+    if (distance) *distance = nearest;
+    return { hit, this };
+  }
+
+  Entity Scene::Pick(Vector2 screenPosition){
+    return Raycast(GetScreenToWorldRay(screenPosition, m_RuntimeCam ? *m_RuntimeCam : m_EditorCam));
+  }
+
+  void Scene::SetEntityName(entt::entity entity, std::string_view name){
+    const StringID id = StringInterner::Intern(name);
+    if (m_Registry.get<TagComponent>(entity).Tag == id) return;
+    // OnTagUpdate moves the index entry
+    m_Registry.patch<TagComponent>(entity, [id](auto& tag) { tag.Tag = id; });
+  }
+
+  // Copies a pool in the source's dense order. Trivially copyable pools are
+  // filled once and then memcpy'd page by page; the rest are copy-constructed.
+  template<typename T>
+  static void CopyPool(const entt::registry& src, entt::registry& dst){
+    const auto* from = src.storage<T>();
+    if (!from || from->empty()) return;
+
+    auto& to = dst.storage<T>();
+    const size_t count = from->size();
+    const entt::entity* entities = from->data();
+    to.reserve(count);
+
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      to.insert(entities, entities + count, from->get(entities[0]));
+      constexpr size_t page = entt::component_traits<T>::page_size;
+      for (size_t i = 0; i < count; i += page)
+	std::memcpy(to.raw()[i / page], from->raw()[i / page], std::min(page, count - i) * sizeof(T));
+    } else {
+      // reverse iteration walks the dense array front to back
+      to.insert(entities, entities + count, from->rbegin());
+    }
+  }
+
+  template<typename... Component>
+  static void CopyPools(ComponentGroup<Component...>, const entt::registry& src, entt::registry& dst){
+    (CopyPool<Component>(src, dst), ...);
+  }
+
+  static void ClearShapeHandles(Shape& shape){
+    shape.btShape = nullptr;
+    for (auto& child : shape.children)
+      ClearShapeHandles(child);
+  }
+
+  Ref<Scene> Scene::Copy(const Ref<Scene>& other){
+    // groups and signals come last: declared on a full registry the groups sort
+    // their pools once instead of reshuffling owned pools while they are copied
+    Ref<Scene> scene(new Scene(false));
+    const entt::registry& src = other->m_Registry;
+    entt::registry& dst = scene->m_Registry;
+
+    // identical ids, versions and free list, so edit-time handles stay valid
+    const auto* entities = src.storage<entt::entity>();
+    auto& dstEntities = dst.storage<entt::entity>();
+    dstEntities.push(entities->data(), entities->data() + entities->size());
+    dstEntities.in_use(entities->in_use());
+
+    CopyPools(AllComponents{}, src, dst);
+    scene->m_EntityIndex = other->m_EntityIndex;
+    scene->m_NameIndex = other->m_NameIndex;
+    scene->m_IndexedNames = other->m_IndexedNames;
+    scene->m_IndexedIDs = other->m_IndexedIDs;
+    scene->m_SpatialIndex = other->m_SpatialIndex;
+    scene->m_SpatialPending = other->m_SpatialPending;
+    scene->SetupRegistry();
+    for (const auto& [type, tracker] : other->m_ChangeTrackers) {
+      auto& copy = scene->m_ChangeTrackers[type];
+      copy = CreateScope<ChangeTracker>(tracker->GetConnector());
+      tracker->GetConnector()(dst, *copy);
+    }
+
+    // physics objects belong to the source's world
+    for (auto [entity, comp] : dst.view<RigidbodyComponent>().each()) {
+      comp.body = nullptr;
+      ClearShapeHandles(comp.shape);
+    }
+    for (auto [entity, comp] : dst.view<TriggerComponent>().each()) {
+      comp.ghost = nullptr;
+      ClearShapeHandles(comp.shape);
+    }
+    for (auto [entity, comp] : dst.view<TerrainComponent>().each())
+      comp.body = nullptr;
+    for (auto [entity, comp] : dst.view<NativeScriptComponent>().each())
+      comp.slot = NativeScriptComponent::NullSlot;
+
+    scene->m_Physics3D.GetCollisionMatrix() = other->m_Physics3D.GetCollisionMatrix();
+    scene->m_Systems = other->m_Systems;
+    // keeps streaming in play; the clone knows which cells the copy already holds
+    if (other->m_WorldPartition)
+      scene->m_WorldPartition = other->m_WorldPartition->Clone(scene.get());
+    scene->m_EditorCam = other->m_EditorCam;
+    scene->testPos = other->testPos;
+    return scene;
+  }
+
+  // 21 bits of v on every third bit, for a 63-bit Morton code
+  static uint64_t SpreadBits(uint64_t v){
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+  }
+
+  // Orders [from, size) of a pool. A group's members sit in front of its owned
+  // pools, so this sorts what the group leaves without disturbing it.
+  template<typename Compare>
+  static void SortTail(entt::sparse_set& pool, size_t from, Compare compare){
+    if (pool.size() <= from + 1) return;
+    std::vector<entt::entity> order(pool.data() + from, pool.data() + pool.size());
+    std::sort(order.begin(), order.end(), compare);
+    for (size_t i = 0; i < order.size(); ++i)
+      if (pool.data()[from + i] != order[i])
+	pool.swap_elements(pool.data()[from + i], order[i]);
+  }
+
+  template<typename... Component>
+  static size_t ComponentSize(ComponentGroup<Component...>, entt::id_type type){
+    size_t size = 0;
+    ((type == entt::type_hash<Component>::value() ? (void)(size = sizeof(Component)) : (void)0), ...);
+    return size;
+  }
+
+  enum OptimizeStage : uint32_t {
+    OPTIMIZE_KEYS, OPTIMIZE_PHYSICS, OPTIMIZE_TRANSFORMS, OPTIMIZE_MODELS,
+    OPTIMIZE_CUBES, OPTIMIZE_FOLLOWERS, OPTIMIZE_SHRINK, OPTIMIZE_DONE
+  };
+
+  // entities created since the keys were taken sort first
+  uint64_t Scene::OptimizeKey(entt::entity entity) const{
+    const size_t index = entt::to_entity(entity);
+    return index < m_OptimizeKeys.size() ? m_OptimizeKeys[index] : 0;
+  }
+
+  void Scene::Optimize(){
+    size_t before = 0, after = 0;
+    for (const auto& pool : GetStorageReport()) before += pool.bytes;
+    m_OptimizeStage = OPTIMIZE_KEYS;
+    while (!OptimizeStep()) {}
+    for (const auto& pool : GetStorageReport()) after += pool.bytes;
+    TraceLog(LOG_INFO, "Optimize: storage %.1f KB -> %.1f KB", before / 1024.0f, after / 1024.0f);
+  }
+
+  bool Scene::OptimizeStep(){
+    auto byKey = [this](const entt::entity a, const entt::entity b) {
+      return OptimizeKey(a) < OptimizeKey(b);
+    };
+
+    switch (m_OptimizeStage) {
+    case OPTIMIZE_KEYS: {
+      Vector3 lo = { FLT_MAX, FLT_MAX, FLT_MAX }, hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      Each<TransformComponent>([&](auto& transform) {
+	lo = Vector3Min(lo, transform.Translation);
+	hi = Vector3Max(hi, transform.Translation);
+      });
+      const Vector3 extent = Vector3Subtract(hi, lo);
+      const float span = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+      const float scale = (float)0x1fffff / span;
+
+      m_OptimizeKeys.assign(m_Registry.storage<entt::entity>().size(), 0);
+      Each<TransformComponent>([&](auto entity, auto& transform) {
+	const Vector3 q = Vector3Scale(Vector3Subtract(transform.Translation, lo), scale);
+	m_OptimizeKeys[entt::to_entity(entity)] =
+	  SpreadBits((uint64_t)q.x) | SpreadBits((uint64_t)q.y) << 1 | SpreadBits((uint64_t)q.z) << 2;
+      });
+      break;
+    }
+    case OPTIMIZE_PHYSICS:
+      // sorts the group's Rigidbody and Transform ranges together
+      PhysicsGroup(m_Registry).sort(byKey);
+      break;
+    case OPTIMIZE_TRANSFORMS:
+      SortTail(m_Registry.storage<TransformComponent>(), PhysicsGroup(m_Registry).size(), byKey);
+      break;
+    case OPTIMIZE_MODELS: {
+      // one asset's instances next to each other, then by position
+      const auto& models = m_Registry.storage<ModelComponent>();
+      ModelGroup(m_Registry).sort([&](const entt::entity a, const entt::entity b) {
+	const auto* assetA = models.get(a).model.get();
+	const auto* assetB = models.get(b).model.get();
+	if (assetA != assetB) return std::less<const void*>()(assetA, assetB);
+	return OptimizeKey(a) < OptimizeKey(b);
+      });
+      m_Registry.sort<AnimationComponent, ModelComponent>();
+      break;
+    }
+    case OPTIMIZE_CUBES:
+      CubeGroup(m_Registry).sort(byKey);
+      break;
+    case OPTIMIZE_FOLLOWERS:
+      m_Registry.sort<IDComponent, TransformComponent>();
+      m_Registry.sort<TagComponent, TransformComponent>();
+      m_Registry.sort<SphereComponent, TransformComponent>();
+      m_Registry.sort<PlaneComponent, TransformComponent>();
+      m_Registry.sort<TriggerComponent, TransformComponent>();
+      m_Registry.sort<NativeScriptComponent, TransformComponent>();
+      break;
+    case OPTIMIZE_SHRINK:
+      for (auto [id, pool] : m_Registry.storage())
+	pool.shrink_to_fit();
+      m_Registry.storage<entt::entity>().shrink_to_fit();
+      m_OptimizeKeys = {};
+      break;
+    }
+    if (++m_OptimizeStage < OPTIMIZE_DONE) return false;
+    m_OptimizeStage = OPTIMIZE_KEYS;
+    return true;
+  }
+
+  std::vector<StoragePoolStats> Scene::GetStorageReport() const{
+    std::vector<StoragePoolStats> report;
+    for (auto [id, pool] : m_Registry.storage()) {
+      StoragePoolStats& stats = report.emplace_back();
+      const size_t element = sizeof(entt::entity) + ComponentSize(AllComponents{}, pool.type().hash());
+      stats.name = pool.type().name();
+      stats.count = pool.size();
+      stats.capacity = std::max(pool.capacity(), pool.size());
+      // the sparse array is paged; extent is an upper bound on what it holds
+      stats.bytes = stats.capacity * element + pool.extent() * sizeof(entt::entity);
+      stats.unusedBytes = stats.bytes - stats.count * (element + sizeof(entt::entity));
+      stats.fragmentation = stats.bytes ? (float)stats.unusedBytes / stats.bytes : 0.0f;
+    }
+    return report;
+  }
+
+  // interned once; unnamed entities share it
+  static StringID DefaultEntityName(){
+    static const StringID id = StringInterner::Intern("Entity");
+    return id;
+  }
+
+  Entity Scene::CreateEntity(std::string_view name)
   {
     return CreateEntityWithUUID(UUID(), name);
   }
 
-  Entity Scene::CreateEntityWithUUID(UUID uuid, const std::string& name)
+  Entity Scene::CreateEntityWithUUID(UUID uuid, std::string_view name)
   {
     Entity entity = { m_Registry.create(), this };
-    // entity.AddComponent<IDComponent>(uuid);
-    auto &id = entity.AddComponent<IDComponent>();
-    id.ID = uuid;
+    entity.AddComponent<IDComponent>(uuid);
     entity.AddComponent<TransformComponent>();
-    auto& tag = entity.AddComponent<TagComponent>();
-    tag.Tag = name.empty() ? "Entity" : name;
+    TagComponent tag;
+    tag.Tag = name.empty() ? DefaultEntityName() : StringInterner::Intern(name);
+    entity.AddComponent<TagComponent>(tag);
     return entity;
   }
 
+  std::vector<entt::entity> Scene::Instantiate(const Prefab& prefab, size_t count, const TransformComponent* transforms)
+  {
+    std::vector<entt::entity> entities(count);
+    if (count == 0) return entities;
+    m_Registry.create(entities.begin(), entities.end());
+    const entt::entity* first = entities.data();
+    const entt::entity* last = first + count;
+
+    // what CreateEntity adds, without the per-entity checks
+    std::vector<IDComponent> ids(count); // a fresh UUID each
+    m_Registry.insert<IDComponent>(first, last, ids.begin());
+    if (transforms)
+      m_Registry.insert<TransformComponent>(first, last, transforms);
+    else
+      m_Registry.insert<TransformComponent>(first, last, prefab.m_Transform);
+    TagComponent tag;
+    tag.Tag = prefab.m_Name;
+    m_Registry.insert<TagComponent>(first, last, tag);
+
+    for (const auto& component : prefab.m_Components)
+      component->Insert(m_Registry, first, last);
+
+    if (m_Physics3D.IsRunning() && prefab.TryGet<RigidbodyComponent>())
+      CreateRigidBodies(first, count);
+    if (m_Physics3D.IsRunning() && prefab.TryGet<TriggerComponent>())
+      CreateTriggers(first, count);
+    return entities;
+  }
+
   void Scene::DestroyEntityNow(Entity entity) { m_Registry.destroy(entity); }
 
   void Scene::DestroyEntity(Entity entity){
@@ -52,76 +788,362 @@ namespace RE {
 
   void Scene::FlushEntityDestruction()
   {
-    if (m_DestroyQueue.empty()) return;    
-    for (auto e : m_DestroyQueue)
-      if (m_Registry.valid(e))
-        m_Registry.destroy(e);
+    if (m_DestroyQueue.empty()) return;
 
+    // range destroy wants each entity once and alive
+    std::sort(m_DestroyQueue.begin(), m_DestroyQueue.end());
+    m_DestroyQueue.erase(std::unique(m_DestroyQueue.begin(), m_DestroyQueue.end()), m_DestroyQueue.end());
+    m_DestroyQueue.erase(std::remove_if(m_DestroyQueue.begin(), m_DestroyQueue.end(),
+					[this](entt::entity e) { return !m_Registry.valid(e); }),
+			 m_DestroyQueue.end());
+    m_Registry.destroy(m_DestroyQueue.begin(), m_DestroyQueue.end());
     m_DestroyQueue.clear();
+
+    FlushReleases();
   }
 
-  void Scene::OnRuntimeStart(){
-    TraceLog(LOG_INFO, "Physics start");
+  CommandBuffer& Scene::GetCommandBuffer()
+  {
+    std::lock_guard<std::mutex> lock(m_CommandMutex);
+    auto [it, inserted] = m_CommandBufferIndex.try_emplace(std::this_thread::get_id(), m_CommandBuffers.size());
+    if (inserted)
+      m_CommandBuffers.push_back(CreateScope<CommandBuffer>());
+    return *m_CommandBuffers[it->second];
+  }
+
+  void Scene::FlushCommandBuffers()
+  {
+    std::lock_guard<std::mutex> lock(m_CommandMutex);
 
-    ViewEntity<Entity, RigidbodyComponent>([this](auto entity, auto &comp) {
-      auto& transform = entity.template GetComponent<TransformComponent>();
-      auto& rigidShape = comp.shape;
-      if(rigidShape.box){
-	if(rigidShape.Dirty || !rigidShape.btShape){
-	  rigidShape.btShape = m_Physics3D.CreateBoxShape(rigidShape.boxSize.x, rigidShape.boxSize.y, rigidShape.boxSize.z);
+    // Buffers belong to threads in first-touch order, so the buffer index only
+    // settles what (type, key, producer) leaves tied; Sorted reports those ties.
+    // type is the component type of component commands, 0 otherwise.
+    struct Entry {
+      entt::id_type type;
+      uint64_t key;
+      uint32_t producer;
+      uint32_t seq;
+      uint32_t buffer;
+      bool operator<(const Entry& o) const {
+	return std::tie(type, key, producer, seq, buffer) < std::tie(o.type, o.key, o.producer, o.seq, o.buffer);
+      }
+    };
+    bool warned = false;
+    auto Sorted = [&warned](std::vector<Entry>& entries) -> std::vector<Entry>& {
+      std::sort(entries.begin(), entries.end());
+      for (size_t i = 1; i < entries.size() && !warned; ++i) {
+	const Entry& a = entries[i - 1];
+	const Entry& b = entries[i];
+	if (a.type == b.type && a.key == b.key && a.producer == b.producer && a.buffer != b.buffer) {
+	  TraceLog(LOG_WARNING, "Command buffers: producer %u recorded key %llu on several threads, "
+		   "playback order is not deterministic", b.producer, (unsigned long long)b.key);
+	  warned = true;
 	}
       }
-      if(rigidShape.sphere){
-        if (rigidShape.Dirty || !rigidShape.btShape) {
-	  rigidShape.btShape = m_Physics3D.CreateSphereShape(rigidShape.radius);
+      return entries;
+    };
+    std::vector<Entry> creates, changes, destroys;
+    for (uint32_t b = 0; b < (uint32_t)m_CommandBuffers.size(); ++b) {
+      const auto& buffer = *m_CommandBuffers[b];
+      for (const auto& cmd : buffer.m_Commands) {
+	Entry entry{ 0, cmd.key, cmd.producer, cmd.seq, b };
+	switch (cmd.op) {
+	case CommandBuffer::Op::Create:  creates.push_back(entry); break;
+	case CommandBuffer::Op::Destroy: destroys.push_back(entry); break;
+	default:
+	  entry.type = buffer.m_Pools[cmd.pool]->type;
+	  changes.push_back(entry);
+	  break;
 	}
       }
+    }
+    if (creates.empty() && changes.empty() && destroys.empty()) return;
 
-      if(rigidShape.plane){
-        if (rigidShape.Dirty || !rigidShape.btShape) {
-	  rigidShape.btShape = m_Physics3D.CreatePlaneShape(rigidShape.planeSize.x, rigidShape.planeSize.y, rigidShape.planeSize.z, 0);
-	}          
+    // creates: one range create, then the components CreateEntity would add
+    if (!creates.empty()) {
+      Sorted(creates);
+      std::vector<entt::entity> entities(creates.size());
+      m_Registry.create(entities.begin(), entities.end());
+
+      std::vector<IDComponent> ids(creates.size());
+      std::vector<TagComponent> tags(creates.size());
+      for (size_t i = 0; i < creates.size(); ++i) {
+	auto& buffer = *m_CommandBuffers[creates[i].buffer];
+	const auto& cmd = buffer.m_Commands[creates[i].seq];
+	buffer.m_Created[cmd.target.placeholder] = entities[i];
+	ids[i].ID = UUID();
+	const StringID name = buffer.m_Names[cmd.index];
+	tags[i].Tag = name ? name : DefaultEntityName();
       }
+      m_Registry.insert<IDComponent>(entities.begin(), entities.end(), ids.begin());
+      m_Registry.insert<TransformComponent>(entities.begin(), entities.end());
+      m_Registry.insert<TagComponent>(entities.begin(), entities.end(), tags.begin());
+    }
 
-      switch (comp.type) {
-      case BodyType::Static:
-        comp.body = m_Physics3D.AddRigidBody(
-            rigidShape.btShape, 0, transform.Translation, transform.Rotation);
-        break;
-      case BodyType::Dynamic:
-        comp.body = m_Physics3D.AddRigidBody(
-            rigidShape.btShape, 1, transform.Translation, transform.Rotation);
-        break;
-      case BodyType::Kinematic:
-	break;
+    // component commands: runs of one type and op, each applied in one call
+    Sorted(changes);
+    std::vector<CommandBuffer::RunItem> run;
+    for (size_t first = 0; first < changes.size();) {
+      CommandBuffer& buffer = *m_CommandBuffers[changes[first].buffer];
+      const auto& cmd = buffer.m_Commands[changes[first].seq];
+      run.clear();
+      size_t last = first;
+      for (; last < changes.size() && changes[last].type == changes[first].type; ++last) {
+	const auto& next = m_CommandBuffers[changes[last].buffer]->m_Commands[changes[last].seq];
+	if (next.op != cmd.op) break;
+	run.push_back({ m_CommandBuffers[changes[last].buffer].get(), changes[last].seq });
       }
+      buffer.m_Pools[cmd.pool]->ApplyRun(*this, cmd.op, run.data(), run.size());
+      first = last;
+    }
+
+    // destroys join the frame's destroy queue and go out in one pass
+    for (const auto& entry : Sorted(destroys)) {
+      auto& buffer = *m_CommandBuffers[entry.buffer];
+      m_DestroyQueue.push_back(buffer.Resolve(buffer.m_Commands[entry.seq].target));
+    }
 
-      comp.savedTranslation = transform.Translation;
-      comp.savedRotation = transform.Rotation;
-      comp.savedScale = transform.Scale;
+    for (auto& buffer : m_CommandBuffers)
+      buffer->Clear();
+  }
+
+  void Scene::OnRuntimeStart(){
+    m_Running = true;
+    TraceLog(LOG_INFO, "Physics start");
+
+    Each<RigidbodyComponent, TransformComponent>([this](auto entity, auto &comp, auto &transform) {
+      CreateRigidBody(entity, comp, transform);
+    });
+
+    ViewEntity<Entity, TerrainComponent, TransformComponent>([this](auto entity, auto &comp, auto &transform) {
+      if (!comp.collision || !comp.terrain || !comp.terrain->IsLoaded()) return;
+      const Terrain& terrain = *comp.terrain;
+      btCollisionShape* shape = m_Physics3D.CreateHeightfieldShape(
+	terrain.GetWidth(), terrain.GetLength(), terrain.GetHeightData(), terrain.GetSettings().heightScale,
+	terrain.GetMinRaw(), terrain.GetMaxRaw(), terrain.GetSettings().cellSize);
+      const Vector3 center = Vector3Add(transform.Translation, terrain.GetCollisionCenter());
+      comp.body = m_Physics3D.AddRigidBody(shape, 0, center, {0, 0, 0}, CollisionLayers::Static);
+      if (comp.body)
+	static_cast<btCollisionObject*>(comp.body)->setUserIndex(static_cast<int>((entt::entity)entity));
+    });
+
+    ViewEntity<Entity, TriggerComponent, TransformComponent>([this](auto entity, auto &comp, auto &transform) {
+      comp.ghost = m_Physics3D.AddTrigger(BuildShape(comp.shape), transform.Translation,
+					  transform.Rotation, comp.layer);
+      if (comp.ghost)
+	static_cast<btCollisionObject*>(comp.ghost)->setUserIndex(static_cast<int>((entt::entity)entity));
     });
 
     m_Physics3D.Start();
+    BakeStaticGeometry();
+
+    // after physics, so OnCreate sees the bodies
+    m_ScriptsRunning = true;
+    for (auto entity : m_Registry.view<NativeScriptComponent>())
+      m_ScriptCreates.push_back(entity);
+    CreatePendingScripts();
   }
 
   void Scene::OnRuntimeStop(){
+    m_Running = false;
+    // OnDestroy may still read physics state
+    StopScripts();
+    ClearStaticGeometry();
+
     TraceLog(LOG_INFO, "Physics stop");
     m_Physics3D.Stop();
     m_Physics3D.Reset();
 
-    ViewEntity<Entity, RigidbodyComponent>([this](auto entity, auto &comp) {
-      auto &transform = entity.template GetComponent<TransformComponent>();
-      transform.Translation = comp.savedTranslation;
-      transform.Rotation = comp.savedRotation;
-      transform.Scale = comp.savedScale;
+    // Reset freed every body and shape already
+    m_BodyReleases.clear();
+    m_TriggerReleases.clear();
+    Each<RigidbodyComponent>([](auto &comp) {
+      comp.body = nullptr;
+      ClearShapeHandles(comp.shape);
+    });
+    ViewEntity<Entity, TriggerComponent>([](auto entity, auto &comp) {
+      comp.ghost = nullptr;
+      ClearShapeHandles(comp.shape);
+    });
+    ViewEntity<Entity, TerrainComponent>([](auto entity, auto &comp) {
+      comp.body = nullptr;
     });
   }
 
+  static CollisionLayer BodyLayer(const RigidbodyComponent& comp){
+    if (comp.type == BodyType::Static && comp.layer == CollisionLayers::Default)
+      return CollisionLayers::Static;
+    return comp.layer;
+  }
+
+  void Scene::CreateRigidBody(entt::entity entity, RigidbodyComponent& comp, TransformComponent& transform){
+    auto& rigidShape = comp.shape;
+    BuildShape(rigidShape);
+
+    const CollisionLayer layer = BodyLayer(comp);
+
+    switch (comp.type) {
+    case BodyType::Static:
+      comp.body = m_Physics3D.AddRigidBody(
+          rigidShape.btShape, 0, transform.Translation, transform.Rotation, layer);
+      break;
+    case BodyType::Dynamic:
+      comp.body = m_Physics3D.AddRigidBody(
+          rigidShape.btShape, 1, transform.Translation, transform.Rotation, layer);
+      break;
+    case BodyType::Kinematic:
+      break;
+    }
+
+    // lets physics callbacks map bodies back to entities
+    if (comp.body)
+      static_cast<btCollisionObject*>(comp.body)->setUserIndex(static_cast<int>(entity));
+  }
+
+  // Bodies for freshly instantiated entities: their rigidbodies are copies of one
+  // template, so the shape is built once and shared.
+  void Scene::CreateRigidBodies(const entt::entity* entities, size_t count){
+    auto& first = m_Registry.get<RigidbodyComponent>(entities[0]);
+    if (first.type == BodyType::Kinematic) return;
+    btCollisionShape* shape = BuildShape(first.shape);
+
+    std::vector<Vector3> positions(count), rotations(count);
+    for (size_t i = 0; i < count; ++i) {
+      const auto& transform = m_Registry.get<TransformComponent>(entities[i]);
+      positions[i] = transform.Translation;
+      rotations[i] = transform.Rotation;
+    }
+
+    std::vector<void*> bodies(count);
+    m_Physics3D.AddRigidBodies(shape, first.type == BodyType::Dynamic ? 1.0f : 0.0f,
+			       positions.data(), rotations.data(), count, BodyLayer(first), bodies.data());
+
+    for (size_t i = 0; i < count; ++i) {
+      auto& comp = m_Registry.get<RigidbodyComponent>(entities[i]);
+      if (i > 0) comp.shape = first.shape; // shares btShape and built children
+      comp.shape.Dirty = false;
+      comp.body = bodies[i];
+      if (comp.body)
+	static_cast<btCollisionObject*>(comp.body)->setUserIndex(static_cast<int>(entities[i]));
+    }
+  }
+
+  // Ghosts for freshly instantiated entities, one shared shape as above
+  void Scene::CreateTriggers(const entt::entity* entities, size_t count){
+    auto& first = m_Registry.get<TriggerComponent>(entities[0]);
+    btCollisionShape* shape = BuildShape(first.shape);
+
+    std::vector<Vector3> positions(count), rotations(count);
+    for (size_t i = 0; i < count; ++i) {
+      const auto& transform = m_Registry.get<TransformComponent>(entities[i]);
+      positions[i] = transform.Translation;
+      rotations[i] = transform.Rotation;
+    }
+
+    std::vector<void*> ghosts(count);
+    m_Physics3D.AddTriggers(shape, positions.data(), rotations.data(), count, first.layer, ghosts.data());
+
+    for (size_t i = 0; i < count; ++i) {
+      auto& comp = m_Registry.get<TriggerComponent>(entities[i]);
+      if (i > 0) comp.shape = first.shape;
+      comp.shape.Dirty = false;
+      comp.ghost = ghosts[i];
+      if (comp.ghost)
+	static_cast<btCollisionObject*>(comp.ghost)->setUserIndex(static_cast<int>(entities[i]));
+    }
+  }
+
+  void Scene::UpdateStreaming(const Camera3D* camera){
+    if (!m_WorldPartition) return;
+    if (!camera)
+      Each<Camera3DComponent>([&camera](auto &comp) {
+	if (comp.Primary) camera = &comp.Camera;
+      });
+    m_WorldPartition->Update(camera ? camera->position : m_EditorCam.position);
+  }
+
+  btCollisionShape* Scene::BuildShape(Shape& shape){
+    if(shape.box){
+      if(shape.Dirty || !shape.btShape){
+	shape.btShape = m_Physics3D.CreateBoxShape(shape.boxSize.x, shape.boxSize.y, shape.boxSize.z);
+      }
+    }
+    if(shape.sphere){
+      if (shape.Dirty || !shape.btShape) {
+	shape.btShape = m_Physics3D.CreateSphereShape(shape.radius);
+      }
+    }
+
+    if(shape.plane){
+      if (shape.Dirty || !shape.btShape) {
+	shape.btShape = m_Physics3D.CreatePlaneShape(shape.planeSize.x, shape.planeSize.y, shape.planeSize.z, 0);
+      }
+    }
+
+    if(shape.compound){
+      if (shape.Dirty || !shape.btShape) {
+	std::vector<CompoundChild> children;
+	children.reserve(shape.children.size());
+	for (auto& child : shape.children) {
+	  // loaded scenes skip AddChild; a plane would give the tree infinite bounds
+	  if (child.plane) {
+	    TraceLog(LOG_ERROR, "Compound shape: plane child skipped");
+	    continue;
+	  }
+	  children.push_back({ BuildShape(child), child.localTranslation, child.localRotation });
+	}
+	shape.btShape = m_Physics3D.CreateCompoundShape(children);
+      }
+    }
+    return shape.btShape;
+  }
+
+  // the pose Physics3D gives a body or compound child: Rotation's z, y, x are
+  // Bullet's yaw, pitch and roll
+  static btTransform PhysicsPose(const Vector3& translation, const Vector3& rotation){
+    btTransform pose;
+    pose.setIdentity();
+    pose.setOrigin(btVector3(translation.x, translation.y, translation.z));
+    pose.setRotation(btQuaternion(btScalar(rotation.z), btScalar(rotation.y), btScalar(rotation.x)));
+    return pose;
+  }
+
+  static entt::entity EntityFromObject(const void* object){
+    if (!object) return entt::null;
+    const int index = static_cast<const btCollisionObject*>(object)->getUserIndex();
+    return index < 0 ? entt::null : static_cast<entt::entity>(index);
+  }
+
+  void Scene::DispatchTriggerEvents(){
+    for (const auto& event : m_Physics3D.GetTriggerEvents()) {
+      const entt::entity self = EntityFromObject(event.trigger);
+      const entt::entity other = EntityFromObject(event.other);
+      if (!m_Registry.valid(self) || !m_Registry.valid(other)) continue;
+
+      auto* trigger = m_Registry.try_get<TriggerComponent>(self);
+      if (!trigger) continue;
+
+      auto& callback = event.entered ? trigger->OnEnter : trigger->OnExit;
+      if (callback)
+	callback(Entity(self, this), Entity(other, this));
+    }
+  }
+
   void Scene::PhysicsUpdate(float dt){
+    // components removed since the last flush must not simulate another step
+    FlushReleases();
+
+    // triggers follow their entity; AABBs are refreshed inside the step
+    Each<TriggerComponent, TransformComponent>([this](auto &trigger, auto &transform) {
+      m_Physics3D.SetTriggerTransform(trigger.ghost, transform.Translation, transform.Rotation);
+    });
+
     m_Physics3D.Step(dt);
+    DispatchTriggerEvents();
 
-    ViewEntity<Entity, RigidbodyComponent>([this](auto entity, auto &comp) {
-      auto &transform = entity.template GetComponent<TransformComponent>();
+    // motion states are only read here, so bodies sync in parallel
+    ParallelEachIn(PhysicsGroup(m_Registry), [](auto entity, auto &comp, auto &transform) {
+      if (!comp.body) return;
       btTransform trans;
       static_cast<btRigidBody*>(comp.body)->getMotionState()->getWorldTransform(trans);
 
@@ -139,11 +1161,21 @@ namespace RE {
       
     });
 
+    // the sync writes in place; report the bodies that can have moved
+    if (ChangeTracker* tracker = FindTracker<TransformComponent>())
+      for (auto [entity, comp, transform] : PhysicsGroup(m_Registry).each())
+	if (comp.body && static_cast<btRigidBody*>(comp.body)->isActive())
+	  tracker->Mark(entity, Changes::Updated);
+
 
 
   }
 
   void Scene::OnUpdate(float dt) {
+    NextChangeFrame();
+    UpdateStreaming(nullptr);
+    m_Transforms.Update(m_Registry);
+    UpdateSpatialIndex();
 
     if (IsMouseButtonPressed(MOUSE_BUTTON_MIDDLE)) {
       inView = true;
@@ -164,30 +1196,14 @@ namespace RE {
       ViewEntity<Entity, Camera3DComponent>([this](auto entity, auto &comp) {
 	DrawCameraFrustum(comp.Camera, 0.1f, 2.0f, SKYBLUE);
       });
-      ViewEntity<Entity, CubeComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawCube(transform.Translation, transform.Scale.x, transform.Scale.y, transform.Scale.z, comp.color);
-      });   
-            
-      ViewEntity<Entity, SphereComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawSphere(transform.Translation, 1.0f, comp.color);
-      });
-
-      ViewEntity<Entity, PlaneComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawPlane(transform.Translation, {transform.Scale.x, transform.Scale.y}, comp.color);
-      });
+      DrawVisible(m_EditorCam);
 
-      ViewEntity<Entity, ModelComponent>([this](auto entity, auto &comp) {
-	auto &transform =
-	  entity.template GetComponent<TransformComponent>();
-	DrawModelEx(comp.model->Data, transform.Translation, transform.Rotation,
-		    1.0f, transform.Scale, comp.color);
+      Each<TransformComponent, TerrainComponent>([this](auto &transform, auto &comp) {
+	if (comp.terrain)
+	  comp.terrain->Draw(m_EditorCam, transform.Translation, comp.color);
       });
 
-      ViewEntity<Entity, AnimationComponent>([this](auto entity, auto &comp) {
-        auto &transform = entity.template GetComponent<TransformComponent>();
+      ViewEntity<Entity, AnimationComponent, TransformComponent>([this](auto entity, auto &comp, auto &transform) {
         if (entity.template HasComponent<ModelComponent>()) {
           auto &model = entity.template GetComponent<ModelComponent>().model;
           unsigned int animIndex = 0;
@@ -199,8 +1215,7 @@ namespace RE {
 	}
       });
 
-      ViewEntity<Entity, RigidbodyComponent>([this](auto entity, auto &comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
+      ViewEntity<Entity, RigidbodyComponent, TransformComponent>([this](auto entity, auto &comp, auto &transform) {
 	auto& rigidShape = comp.shape;
 	if(rigidShape.box){
 	  if(rigidShape.Dirty || !rigidShape.btShape){
@@ -227,6 +1242,23 @@ namespace RE {
                   ->getPlaneNormal();
 	  DrawPlane(transform.Translation, {shapeSize.x(), shapeSize.z()}, MAROON);
 	}
+
+	// drawn from the authored children, no Bullet shapes needed in edit mode,
+	// each posed the way the compound places it on the rotated body
+	const btTransform body = PhysicsPose(transform.Translation, transform.Rotation);
+	for (const auto& child : rigidShape.children) {
+	  btScalar pose[16];
+	  (body * PhysicsPose(child.localTranslation, child.localRotation)).getOpenGLMatrix(pose);
+	  float matrix[16];
+	  for (int i = 0; i < 16; ++i) matrix[i] = (float)pose[i];
+	  rlPushMatrix();
+	  rlMultMatrixf(matrix);
+	  if (child.box)
+	    DrawCubeWiresV({ 0.0f, 0.0f, 0.0f }, child.boxSize, MAROON);
+	  if (child.sphere)
+	    DrawSphereWires({ 0.0f, 0.0f, 0.0f }, child.radius, 4, 4, MAROON);
+	  rlPopMatrix();
+	}
       });
 
       ViewEntity<Entity, SkyboxComponent>([this](auto entity, auto &comp) {
@@ -244,6 +1276,7 @@ namespace RE {
 
     DrawFPS(10,10);
 
+    FlushCommandBuffers();
     FlushEntityDestruction();
   }
   void Scene::OnUpdateRuntime(float dt){
@@ -257,29 +1290,23 @@ namespace RE {
                 
     ClearBackground(RAYWHITE);
 
+    NextChangeFrame();
+    UpdateStreaming(m_RuntimeCam);
+    UpdateScripts(dt);
+    m_Systems.Run(*this, m_Registry, dt);
+    m_Ticks.Tick(dt);
     PhysicsUpdate(dt);
+    m_Transforms.Update(m_Registry);
+    UpdateSpatialIndex();
 
     if(m_RuntimeCam){
       BeginMode3D(*m_RuntimeCam);      
 
-      ViewEntity<Entity, CubeComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawCube(transform.Translation, transform.Scale.x, transform.Scale.y, transform.Scale.z, comp.color);
-      });
-
-      ViewEntity<Entity, SphereComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawSphere(transform.Translation, 1.0f, comp.color);
-      });
+      DrawVisible(*m_RuntimeCam);
 
-      ViewEntity<Entity, PlaneComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawPlane(transform.Translation, {transform.Scale.x, transform.Scale.y}, comp.color);
-      });  
-            
-      ViewEntity<Entity, ModelComponent>([this](auto entity, auto& comp) {
-	auto& transform = entity.template GetComponent<TransformComponent>();
-	DrawModelEx(comp.model->Data, transform.Translation, transform.Rotation, 1.0f, transform.Scale, comp.color);
+      Each<TransformComponent, TerrainComponent>([this](auto &transform, auto &comp) {
+	if (comp.terrain)
+	  comp.terrain->Draw(*m_RuntimeCam, transform.Translation, comp.color);
       });
 
       ViewEntity<Entity, SkyboxComponent>([&](auto entity, auto &comp) {
@@ -299,6 +1326,7 @@ namespace RE {
       DrawText("NO PRIMARY CAM", 40, 80, 10, RED);
     }            
 
+    FlushCommandBuffers();
     FlushEntityDestruction();
   }
 
@@ -349,4 +1377,20 @@ namespace RE {
   template <>
   void Scene::OnComponentAdded<RigidbodyComponent>(Entity entity, RigidbodyComponent& component)
   {}
+
+  template <>
+  void Scene::OnComponentAdded<TriggerComponent>(Entity entity, TriggerComponent& component)
+  {}
+
+  template <>
+  void Scene::OnComponentAdded<TerrainComponent>(Entity entity, TerrainComponent& component)
+  {}
+
+  template <>
+  void Scene::OnComponentAdded<StaticComponent>(Entity entity, StaticComponent& component)
+  {}
+
+  template <>
+  void Scene::OnComponentAdded<NativeScriptComponent>(Entity entity, NativeScriptComponent& component)
+  {}
 }
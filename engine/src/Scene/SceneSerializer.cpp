@@ -0,0 +1,497 @@
+#include "repch.h"
+#include "Scene/SceneSerializer.h"
+#include "Scene/Scene.h"
+#include "Scene/Components.h"
+#include <cstring>
+
+#ifdef RE_PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RE {
+
+  namespace {
+
+    constexpr uint32_t SCENE_MAGIC = 0x4E435352; // "RSCN"
+    constexpr uint32_t SCENE_VERSION = 3;
+    constexpr size_t SCENE_ALIGN = 16;
+
+    enum class Section : uint32_t {
+      ID = 1, Tag, Transform, Cube, Sphere, Plane, Camera3D, Model, Skybox, Rigidbody, Static
+    };
+
+    struct FileHeader {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t entityCount;
+      uint32_t sectionCount;
+      uint64_t stringsOffset;
+      uint64_t stringsSize;
+    };
+
+    // Dense sections hold one record per file entity, in order, and no index array.
+    // Sparse index arrays are strictly ascending so slices can be loaded in order.
+    struct SectionHeader {
+      uint32_t type;
+      uint32_t stride;
+      uint32_t count;
+      uint32_t dense;
+      uint64_t indexOffset;
+      uint64_t dataOffset;
+    };
+
+    // names are stored once in the string table; `id` is the StringID they hash to
+    struct TagRecord {
+      StringID id;
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    struct ModelRecord {
+      AssetID model;
+      Color color;
+      BoundingBox box;
+    };
+
+    struct SkyboxRecord {
+      AssetID skybox;
+    };
+
+    enum class ShapeKind : uint8_t { Box = 1, Sphere, Plane };
+
+    struct RigidbodyRecord {
+      uint8_t type;
+      uint8_t layer;
+      uint8_t shape;
+      uint8_t pad;
+      float radius;
+      Vector3 boxSize;
+      Vector3 planeSize;
+    };
+
+    // pools stored byte for byte
+    static_assert(std::is_trivially_copyable_v<IDComponent>);
+    static_assert(std::is_trivially_copyable_v<TransformComponent>);
+    static_assert(std::is_trivially_copyable_v<CubeComponent>);
+    static_assert(std::is_trivially_copyable_v<SphereComponent>);
+    static_assert(std::is_trivially_copyable_v<PlaneComponent>);
+    static_assert(std::is_trivially_copyable_v<Camera3DComponent>);
+    static_assert(std::is_trivially_copyable_v<StaticComponent>);
+
+    struct Writer {
+      std::vector<uint8_t> payload;
+      std::vector<SectionHeader> sections;
+      std::string strings;
+      std::unordered_map<StringID, TagRecord> names;
+
+      uint64_t Append(const void* data, size_t size) {
+	payload.resize((payload.size() + SCENE_ALIGN - 1) & ~(SCENE_ALIGN - 1));
+	const uint64_t offset = payload.size();
+	payload.insert(payload.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	return offset;
+      }
+    };
+
+    // Write every T owned by `entities` as one section of Records. Walking the
+    // entity list keeps the owner indices ascending. convert(comp, record) may
+    // return false to leave a component out.
+    template<typename T, typename Record, typename Convert>
+    void WritePool(entt::registry& registry, const std::vector<entt::entity>& entities,
+		   Section type, Writer& writer, Convert&& convert) {
+      std::vector<uint32_t> owners;
+      std::vector<Record> records;
+      for (uint32_t i = 0; i < (uint32_t)entities.size(); ++i) {
+	const T* comp = registry.try_get<T>(entities[i]);
+	Record record{};
+	if (!comp || !convert(*comp, record)) continue;
+	owners.push_back(i);
+	records.push_back(record);
+      }
+      if (records.empty()) return;
+
+      SectionHeader section{};
+      section.type = (uint32_t)type;
+      section.stride = sizeof(Record);
+      section.count = (uint32_t)records.size();
+      section.dense = records.size() == entities.size();
+      if (!section.dense)
+	section.indexOffset = writer.Append(owners.data(), owners.size() * sizeof(uint32_t));
+      section.dataOffset = writer.Append(records.data(), records.size() * sizeof(Record));
+      writer.sections.push_back(section);
+    }
+
+    template<typename T>
+    void WritePool(entt::registry& registry, const std::vector<entt::entity>& entities,
+		   Section type, Writer& writer) {
+      WritePool<T, T>(registry, entities, type, writer, [](const T& comp, T& record) {
+	record = comp;
+	return true;
+      });
+    }
+
+    template<typename T>
+    Ref<T> ResolveAsset(AssetRegistry& assets, AssetID id) {
+      auto& map = assets.GetMap<T>();
+      auto it = map.find(id);
+      if (it == map.end()) {
+	TraceLog(LOG_WARNING, "Scene references missing asset %llu", (unsigned long long)id);
+	it = map.find(EMPTY_ASSET);
+      }
+      return std::static_pointer_cast<T>(it->second);
+    }
+  }
+
+  // Read-only view of a whole file. mmap on Linux; elsewhere the file is read
+  // into memory (windows.h and raylib.h cannot share a translation unit).
+  class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path) {
+#ifdef RE_PLATFORM_LINUX
+      const int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0) return;
+      struct stat st {};
+      if (fstat(fd, &st) == 0 && st.st_size > 0) {
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED) {
+	  m_Data = (const uint8_t*)data;
+	  m_Size = (size_t)st.st_size;
+	  madvise(data, m_Size, MADV_WILLNEED);
+	}
+      }
+      close(fd);
+#else
+      std::ifstream file(path, std::ios::binary | std::ios::ate);
+      if (!file) return;
+      m_Buffer.resize((size_t)file.tellg());
+      file.seekg(0);
+      file.read((char*)m_Buffer.data(), (std::streamsize)m_Buffer.size());
+      m_Data = m_Buffer.data();
+      m_Size = m_Buffer.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef RE_PLATFORM_LINUX
+      if (m_Data) munmap((void*)m_Data, m_Size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+    bool Contains(uint64_t offset, uint64_t size) const {
+      return offset <= m_Size && size <= m_Size - offset;
+    }
+
+    // fault every page in now so later reads do not block
+    void Touch() const {
+      volatile uint8_t sink = 0;
+      for (size_t i = 0; i < m_Size; i += 4096)
+	sink = sink + m_Data[i];
+      (void)sink;
+    }
+
+  private:
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+#ifndef RE_PLATFORM_LINUX
+    std::vector<uint8_t> m_Buffer;
+#endif
+  };
+
+  // --- Saving ----------------------------------------------------------------------
+  bool SceneSerializer::SerializeBinary(const std::string& path) {
+    // every scene entity has an IDComponent; its pool order becomes file order
+    auto ids = m_Scene->m_Registry.view<IDComponent>();
+    return SerializeBinary(path, std::vector<entt::entity>(ids.begin(), ids.end()));
+  }
+
+  bool SceneSerializer::SerializeBinary(const std::string& path, const std::vector<entt::entity>& entities) {
+    auto& registry = m_Scene->m_Registry;
+    for (auto entity : entities)
+      if (!registry.all_of<IDComponent>(entity)) {
+	TraceLog(LOG_ERROR, "Cannot save an entity without IDComponent");
+	return false;
+      }
+
+    Writer writer;
+    WritePool<IDComponent>(registry, entities, Section::ID, writer);
+    WritePool<TagComponent, TagRecord>(registry, entities, Section::Tag, writer,
+				       [&writer](const TagComponent& comp, TagRecord& record) {
+      auto [it, inserted] = writer.names.try_emplace(comp.Tag);
+      if (inserted) {
+	const std::string_view name = comp.GetName();
+	it->second = { comp.Tag, (uint32_t)writer.strings.size(), (uint32_t)name.size() };
+	writer.strings += name;
+      }
+      record = it->second;
+      return true;
+    });
+    WritePool<TransformComponent>(registry, entities, Section::Transform, writer);
+    WritePool<CubeComponent>(registry, entities, Section::Cube, writer);
+    WritePool<SphereComponent>(registry, entities, Section::Sphere, writer);
+    WritePool<PlaneComponent>(registry, entities, Section::Plane, writer);
+    WritePool<Camera3DComponent>(registry, entities, Section::Camera3D, writer);
+    WritePool<StaticComponent>(registry, entities, Section::Static, writer);
+    WritePool<ModelComponent, ModelRecord>(registry, entities, Section::Model, writer,
+					   [](const ModelComponent& comp, ModelRecord& record) {
+      record = { comp.model ? comp.model->UUID : EMPTY_ASSET, comp.color, comp.box };
+      return true;
+    });
+    WritePool<SkyboxComponent, SkyboxRecord>(registry, entities, Section::Skybox, writer,
+					     [](const SkyboxComponent& comp, SkyboxRecord& record) {
+      record = { comp.skybox ? comp.skybox->UUID : EMPTY_ASSET };
+      return true;
+    });
+    WritePool<RigidbodyComponent, RigidbodyRecord>(registry, entities, Section::Rigidbody, writer,
+						   [](const RigidbodyComponent& comp, RigidbodyRecord& record) {
+      const Shape& shape = comp.shape;
+      if (shape.box) record.shape = (uint8_t)ShapeKind::Box;
+      else if (shape.sphere) record.shape = (uint8_t)ShapeKind::Sphere;
+      else if (shape.plane) record.shape = (uint8_t)ShapeKind::Plane;
+      else {
+	TraceLog(LOG_WARNING, "Only box, sphere and plane rigidbodies are saved");
+	return false;
+      }
+      record.type = (uint8_t)comp.type;
+      record.layer = comp.layer;
+      record.radius = shape.radius;
+      record.boxSize = shape.boxSize;
+      record.planeSize = shape.planeSize;
+      return true;
+    });
+    const uint64_t stringsOffset = writer.Append(writer.strings.data(), writer.strings.size());
+
+    // payload offsets become file offsets once the header block size is known
+    size_t base = sizeof(FileHeader) + writer.sections.size() * sizeof(SectionHeader);
+    base = (base + SCENE_ALIGN - 1) & ~(SCENE_ALIGN - 1);
+    for (auto& section : writer.sections) {
+      if (!section.dense) section.indexOffset += base;
+      section.dataOffset += base;
+    }
+
+    FileHeader header{};
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.entityCount = (uint32_t)entities.size();
+    header.sectionCount = (uint32_t)writer.sections.size();
+    header.stringsOffset = stringsOffset + base;
+    header.stringsSize = writer.strings.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      TraceLog(LOG_ERROR, "Cannot write scene %s", path.c_str());
+      return false;
+    }
+    std::vector<uint8_t> head(base, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    if (!writer.sections.empty())
+      std::memcpy(head.data() + sizeof(header), writer.sections.data(), writer.sections.size() * sizeof(SectionHeader));
+    file.write((const char*)head.data(), (std::streamsize)head.size());
+    file.write((const char*)writer.payload.data(), (std::streamsize)writer.payload.size());
+    return (bool)file;
+  }
+
+  bool SceneSerializer::DeserializeBinary(const std::string& path) {
+    SceneLoader loader;
+    if (!loader.Open(path)) return false;
+    loader.Integrate(*m_Scene, m_Assets, loader.GetEntityCount());
+    TraceLog(LOG_INFO, "Loaded scene %s (%u entities)", path.c_str(), loader.GetEntityCount());
+    return true;
+  }
+
+  // --- Loading ---------------------------------------------------------------------
+  SceneLoader::SceneLoader() = default;
+  SceneLoader::~SceneLoader() = default;
+
+  bool SceneLoader::Open(const std::string& path) {
+    m_Path = path;
+    m_File = CreateScope<MappedFile>(path);
+    const MappedFile& file = *m_File;
+    if (!file.Data() || !file.Contains(0, sizeof(FileHeader))) {
+      TraceLog(LOG_ERROR, "Cannot read scene %s", path.c_str());
+      m_File.reset();
+      return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (header.magic != SCENE_MAGIC || header.version != SCENE_VERSION) {
+      TraceLog(LOG_ERROR, "%s is not a version %u scene file", path.c_str(), SCENE_VERSION);
+      m_File.reset();
+      return false;
+    }
+
+    bool valid = file.Contains(sizeof(FileHeader), (uint64_t)header.sectionCount * sizeof(SectionHeader)) &&
+      file.Contains(header.stringsOffset, header.stringsSize);
+    const auto* sections = (const SectionHeader*)(file.Data() + sizeof(FileHeader));
+    for (uint32_t s = 0; valid && s < header.sectionCount; ++s) {
+      const auto& section = sections[s];
+      valid = (section.dense
+	       ? section.count == header.entityCount
+	       : file.Contains(section.indexOffset, (uint64_t)section.count * sizeof(uint32_t))) &&
+	file.Contains(section.dataOffset, (uint64_t)section.count * section.stride) &&
+	section.dataOffset % SCENE_ALIGN == 0;
+      if (valid && !section.dense) {
+	const auto* index = (const uint32_t*)(file.Data() + section.indexOffset);
+	for (uint32_t i = 0; valid && i < section.count; ++i)
+	  valid = index[i] < header.entityCount && (i == 0 || index[i - 1] < index[i]);
+      }
+    }
+    if (!valid) {
+      TraceLog(LOG_ERROR, "Scene %s is corrupt", path.c_str());
+      m_File.reset();
+      return false;
+    }
+
+    file.Touch();
+    m_EntityCount = header.entityCount;
+    m_SectionCount = header.sectionCount;
+    m_Cursors.assign(m_SectionCount, 0);
+    m_Next = 0;
+    return true;
+  }
+
+  size_t SceneLoader::Integrate(Scene& scene, AssetRegistry* assets, size_t budget,
+				std::vector<entt::entity>* created) {
+    if (!m_File || Done() || budget == 0) return 0;
+
+    const MappedFile& file = *m_File;
+    FileHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    const auto* sections = (const SectionHeader*)(file.Data() + sizeof(FileHeader));
+    const char* strings = (const char*)file.Data() + header.stringsOffset;
+
+    const uint32_t begin = m_Next;
+    const uint32_t end = (uint32_t)std::min<size_t>(m_EntityCount, begin + budget);
+
+    auto& registry = scene.m_Registry;
+    std::vector<entt::entity> entities(end - begin);
+    registry.create(entities.begin(), entities.end());
+
+    std::vector<entt::entity> owners;
+    for (uint32_t s = 0; s < m_SectionCount; ++s) {
+      const auto& section = sections[s];
+
+      // records of this section that belong to [begin, end)
+      uint32_t first = m_Cursors[s];
+      uint32_t last = first;
+      owners.clear();
+      if (section.dense) {
+	last = end;
+	owners.assign(entities.begin(), entities.end());
+      } else {
+	const auto* index = (const uint32_t*)(file.Data() + section.indexOffset);
+	while (last < section.count && index[last] < end)
+	  owners.push_back(entities[index[last++] - begin]);
+      }
+      m_Cursors[s] = last;
+      if (first == last) continue;
+
+      const uint8_t* data = file.Data() + section.dataOffset + (size_t)first * section.stride;
+      const uint32_t count = last - first;
+
+      // trivially copyable pools go straight from the mapping into storage
+      auto insertRaw = [&](auto tag) {
+	using T = typename decltype(tag)::type;
+	if (section.stride != sizeof(T)) {
+	  TraceLog(LOG_ERROR, "Scene %s: component layout changed, section %u skipped", m_Path.c_str(), section.type);
+	  return;
+	}
+	registry.insert<T>(owners.begin(), owners.end(), (const T*)data);
+      };
+
+      switch ((Section)section.type) {
+      case Section::ID:        insertRaw(std::type_identity<IDComponent>{}); break;
+      case Section::Transform: insertRaw(std::type_identity<TransformComponent>{}); break;
+      case Section::Cube:      insertRaw(std::type_identity<CubeComponent>{}); break;
+      case Section::Sphere:    insertRaw(std::type_identity<SphereComponent>{}); break;
+      case Section::Plane:     insertRaw(std::type_identity<PlaneComponent>{}); break;
+      case Section::Camera3D:  insertRaw(std::type_identity<Camera3DComponent>{}); break;
+      case Section::Static:    insertRaw(std::type_identity<StaticComponent>{}); break;
+
+      case Section::Tag: {
+	if (section.stride != sizeof(TagRecord)) break;
+	const auto* records = (const TagRecord*)data;
+	std::vector<TagComponent> tags(count);
+	// shared names are interned once per file
+	std::unordered_map<uint32_t, StringID> interned;
+	for (uint32_t i = 0; i < count; ++i) {
+	  if ((uint64_t)records[i].offset + records[i].length > header.stringsSize) continue;
+	  auto [it, inserted] = interned.try_emplace(records[i].offset);
+	  if (inserted)
+	    it->second = StringInterner::Intern(std::string_view(strings + records[i].offset, records[i].length));
+	  tags[i].Tag = it->second;
+	}
+	registry.insert<TagComponent>(owners.begin(), owners.end(), tags.begin());
+	break;
+      }
+
+      case Section::Model: {
+	if (section.stride != sizeof(ModelRecord)) break;
+	if (!assets) {
+	  TraceLog(LOG_ERROR, "Scene %s references models but no AssetRegistry was given", m_Path.c_str());
+	  break;
+	}
+	const auto* records = (const ModelRecord*)data;
+	std::vector<ModelComponent> models(count);
+	for (uint32_t i = 0; i < count; ++i) {
+	  models[i].model = ResolveAsset<ModelAsset>(*assets, records[i].model);
+	  models[i].color = records[i].color;
+	  models[i].box = records[i].box;
+	}
+	registry.insert<ModelComponent>(owners.begin(), owners.end(), models.begin());
+	break;
+      }
+
+      case Section::Skybox: {
+	if (section.stride != sizeof(SkyboxRecord)) break;
+	if (!assets) {
+	  TraceLog(LOG_ERROR, "Scene %s references skyboxes but no AssetRegistry was given", m_Path.c_str());
+	  break;
+	}
+	const auto* records = (const SkyboxRecord*)data;
+	std::vector<SkyboxComponent> skyboxes(count);
+	for (uint32_t i = 0; i < count; ++i)
+	  skyboxes[i].skybox = ResolveAsset<SkyboxAsset>(*assets, records[i].skybox);
+	registry.insert<SkyboxComponent>(owners.begin(), owners.end(), skyboxes.begin());
+	break;
+      }
+
+      case Section::Rigidbody: {
+	if (section.stride != sizeof(RigidbodyRecord)) break;
+	const auto* records = (const RigidbodyRecord*)data;
+	std::vector<RigidbodyComponent> bodies(count);
+	for (uint32_t i = 0; i < count; ++i) {
+	  const auto& record = records[i];
+	  auto& body = bodies[i];
+	  body.body = nullptr;
+	  body.type = (BodyType)record.type;
+	  body.layer = record.layer;
+	  switch ((ShapeKind)record.shape) {
+	  case ShapeKind::Box:    body.shape = BoxShape(record.boxSize); break;
+	  case ShapeKind::Sphere: body.shape = SphereShape(record.radius); break;
+	  case ShapeKind::Plane:  body.shape = PlaneShape(record.planeSize); break;
+	  }
+	}
+	registry.insert<RigidbodyComponent>(owners.begin(), owners.end(), bodies.begin());
+	break;
+      }
+
+      default:
+	break;
+      }
+    }
+
+    m_Next = end;
+    if (Done()) m_File.reset();
+    if (created) created->insert(created->end(), entities.begin(), entities.end());
+    return entities.size();
+  }
+}
@@ -0,0 +1,227 @@
+#include "repch.h"
+#include "Scene/StaticGeometry.h"
+#include "Scene/Components.h"
+#include "Scene/TransformPool.h"
+#include "raymath.h"
+#include "rlgl.h"
+#include "Auxiliaries/rayext.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace RE {
+
+  namespace {
+    constexpr int MAX_VERTICES = 65535; // raylib indices are unsigned short
+
+    // grid cell, then material (diffuse texture and color, the default shader's inputs)
+    using BucketKey = std::tuple<int, int, int, unsigned int, uint32_t>;
+  }
+
+  static bool Mergeable(const Model& model){
+    if (model.meshCount == 0 || model.boneCount > 0) return false;
+    for (int i = 0; i < model.meshCount; ++i) {
+      const Mesh& mesh = model.meshes[i];
+      if (!mesh.vertices || mesh.vertexCount <= 0 || mesh.vertexCount > MAX_VERTICES) return false;
+      if (model.materials[model.meshMaterial[i]].shader.id != rlGetShaderIdDefault()) return false;
+    }
+    return true;
+  }
+
+  static int IndexCount(const Mesh& mesh){
+    return mesh.indices ? mesh.triangleCount * 3 : mesh.vertexCount;
+  }
+
+  static Vector3 TransformDirection(Vector3 d, const Matrix& m){
+    return { m.m0 * d.x + m.m4 * d.y + m.m8 * d.z,
+	     m.m1 * d.x + m.m5 * d.y + m.m9 * d.z,
+	     m.m2 * d.x + m.m6 * d.y + m.m10 * d.z };
+  }
+
+  // one world-space mesh from `count` pieces, uploaded; bounds grow to fit it
+  Mesh StaticGeometry::MergeMesh(const Piece* pieces, size_t count, int vertexCount, int indexCount, BoundingBox& bounds){
+    Mesh mesh{};
+    mesh.vertexCount = vertexCount;
+    mesh.triangleCount = indexCount / 3;
+    // raylib frees these in UnloadMesh
+    mesh.vertices = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
+    mesh.texcoords = (float*)MemAlloc(vertexCount * 2 * sizeof(float));
+    mesh.normals = (float*)MemAlloc(vertexCount * 3 * sizeof(float));
+    mesh.colors = (unsigned char*)MemAlloc(vertexCount * 4);
+    mesh.indices = (unsigned short*)MemAlloc(indexCount * sizeof(unsigned short));
+
+    int base = 0, index = 0;
+    for (size_t p = 0; p < count; ++p) {
+      const Mesh& src = *pieces[p].mesh;
+      const Matrix& transform = pieces[p].transform;
+      const Matrix normalMatrix = MatrixTranspose(MatrixInvert(transform));
+      const Color tint = pieces[p].tint;
+
+      for (int k = 0; k < src.vertexCount; ++k) {
+	const int v = base + k;
+	const Vector3 position = Vector3Transform({ src.vertices[3 * k], src.vertices[3 * k + 1], src.vertices[3 * k + 2] }, transform);
+	mesh.vertices[3 * v] = position.x;
+	mesh.vertices[3 * v + 1] = position.y;
+	mesh.vertices[3 * v + 2] = position.z;
+	bounds.min = Vector3Min(bounds.min, position);
+	bounds.max = Vector3Max(bounds.max, position);
+
+	const Vector3 normal = src.normals
+	  ? Vector3Normalize(TransformDirection({ src.normals[3 * k], src.normals[3 * k + 1], src.normals[3 * k + 2] }, normalMatrix))
+	  : Vector3{ 0.0f, 1.0f, 0.0f };
+	mesh.normals[3 * v] = normal.x;
+	mesh.normals[3 * v + 1] = normal.y;
+	mesh.normals[3 * v + 2] = normal.z;
+
+	mesh.texcoords[2 * v] = src.texcoords ? src.texcoords[2 * k] : 0.0f;
+	mesh.texcoords[2 * v + 1] = src.texcoords ? src.texcoords[2 * k + 1] : 0.0f;
+
+	const unsigned char* color = src.colors ? &src.colors[4 * k] : nullptr;
+	mesh.colors[4 * v] = (unsigned char)((color ? color[0] : 255) * tint.r / 255);
+	mesh.colors[4 * v + 1] = (unsigned char)((color ? color[1] : 255) * tint.g / 255);
+	mesh.colors[4 * v + 2] = (unsigned char)((color ? color[2] : 255) * tint.b / 255);
+	mesh.colors[4 * v + 3] = (unsigned char)((color ? color[3] : 255) * tint.a / 255);
+      }
+
+      if (src.indices) {
+	for (int i = 0; i < src.triangleCount * 3; ++i)
+	  mesh.indices[index++] = (unsigned short)(base + src.indices[i]);
+      } else {
+	for (int k = 0; k < src.vertexCount; ++k)
+	  mesh.indices[index++] = (unsigned short)(base + k);
+      }
+      base += src.vertexCount;
+    }
+
+    UploadMesh(&mesh, false);
+    return mesh;
+  }
+
+  void StaticGeometry::Bake(const entt::registry& registry, const TransformPool& transforms, float cellSize){
+    Clear();
+    const float inverseCell = cellSize > 0.0f ? 1.0f / cellSize : 0.0f;
+
+    std::map<BucketKey, Cluster> buckets;
+    for (auto [entity, comp] : registry.view<ModelComponent>().each()) {
+      const auto* flag = registry.try_get<StaticComponent>(entity);
+      const auto* body = registry.try_get<RigidbodyComponent>(entity);
+      const bool isStatic = flag ? flag->batch : body && body->type == BodyType::Static;
+      if (!isStatic || registry.all_of<AnimationComponent>(entity)) continue;
+      if (!comp.model || !Mergeable(comp.model->Data)) continue;
+      const Matrix* world = transforms.Find(entity);
+      if (!world) continue;
+
+      const Model& model = comp.model->Data;
+      const Matrix transform = MatrixMultiply(model.transform, *world);
+      const int cx = (int)std::floor(world->m12 * inverseCell);
+      const int cy = (int)std::floor(world->m13 * inverseCell);
+      const int cz = (int)std::floor(world->m14 * inverseCell);
+      for (int i = 0; i < model.meshCount; ++i) {
+	const Material& material = model.materials[model.meshMaterial[i]];
+	const MaterialMap& diffuse = material.maps[MATERIAL_MAP_DIFFUSE];
+	const uint32_t color = (uint32_t)diffuse.color.r << 24 | (uint32_t)diffuse.color.g << 16 |
+	  (uint32_t)diffuse.color.b << 8 | diffuse.color.a;
+	Cluster& cluster = buckets[BucketKey{ cx, cy, cz, diffuse.texture.id, color }];
+	if (cluster.pieces.empty()) cluster.material = material;
+	cluster.pieces.push_back({ &model.meshes[i], transform, comp.color, entity });
+      }
+      if (m_Assets.empty() || m_Assets.back() != comp.model) m_Assets.push_back(comp.model);
+
+      const size_t index = entt::to_entity(entity);
+      if (index >= m_Baked.size()) m_Baked.resize(index + 1);
+      m_Baked[index].entity = entity;
+      ++m_BakedCount;
+    }
+    std::sort(m_Assets.begin(), m_Assets.end());
+    m_Assets.erase(std::unique(m_Assets.begin(), m_Assets.end()), m_Assets.end());
+
+    // the map keeps the clusters of a cell together: an entity's range is its cell's
+    m_Clusters.reserve(buckets.size());
+    for (auto& [key, bucket] : buckets) {
+      const uint32_t c = (uint32_t)m_Clusters.size();
+      Cluster& cluster = m_Clusters.emplace_back(std::move(bucket));
+      for (const Piece& piece : cluster.pieces) {
+	Baked& baked = m_Baked[entt::to_entity(piece.entity)];
+	if (baked.lastCluster == 0) baked.firstCluster = c;
+	baked.lastCluster = c + 1;
+      }
+      Merge(cluster);
+    }
+    TraceLog(LOG_INFO, "Static geometry: %zu entities merged into %zu meshes", m_BakedCount, m_BatchCount);
+  }
+
+  void StaticGeometry::Merge(Cluster& cluster){
+    const auto& pieces = cluster.pieces;
+    // as many pieces per mesh as its index range allows
+    for (size_t first = 0; first < pieces.size();) {
+      size_t last = first;
+      int vertexCount = 0, indexCount = 0;
+      while (last < pieces.size() && vertexCount + pieces[last].mesh->vertexCount <= MAX_VERTICES) {
+	vertexCount += pieces[last].mesh->vertexCount;
+	indexCount += IndexCount(*pieces[last].mesh);
+	++last;
+      }
+      Batch& batch = cluster.batches.emplace_back();
+      batch.bounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+      batch.mesh = MergeMesh(pieces.data() + first, last - first, vertexCount, indexCount, batch.bounds);
+      first = last;
+    }
+    m_BatchCount += cluster.batches.size();
+    cluster.dirty = false;
+  }
+
+  void StaticGeometry::Unload(Cluster& cluster){
+    // the material belongs to the model asset
+    for (auto& batch : cluster.batches)
+      UnloadMesh(batch.mesh);
+    m_BatchCount -= cluster.batches.size();
+    cluster.batches.clear();
+  }
+
+  void StaticGeometry::Clear(){
+    for (auto& cluster : m_Clusters)
+      Unload(cluster);
+    m_Clusters.clear();
+    m_Assets.clear();
+    m_Baked.clear();
+    m_BakedCount = 0;
+    m_DrawCalls = 0;
+    m_Dirty = false;
+  }
+
+  void StaticGeometry::Remove(entt::entity entity){
+    if (!IsBaked(entity)) return;
+    Baked& baked = m_Baked[entt::to_entity(entity)];
+    for (uint32_t c = baked.firstCluster; c < baked.lastCluster; ++c) {
+      auto& pieces = m_Clusters[c].pieces;
+      const size_t count = pieces.size();
+      pieces.erase(std::remove_if(pieces.begin(), pieces.end(),
+				  [entity](const Piece& piece) { return piece.entity == entity; }),
+		   pieces.end());
+      if (pieces.size() != count) m_Clusters[c].dirty = m_Dirty = true;
+    }
+    baked = {};
+    --m_BakedCount;
+  }
+
+  void StaticGeometry::Draw(const Frustum& frustum){
+    if (m_Dirty) {
+      for (auto& cluster : m_Clusters)
+	if (cluster.dirty) {
+	  Unload(cluster);
+	  Merge(cluster);
+	}
+      m_Dirty = false;
+    }
+
+    m_DrawCalls = 0;
+    for (const auto& cluster : m_Clusters)
+      for (const auto& batch : cluster.batches)
+	if (FrustumIntersectsBox(frustum, batch.bounds)) {
+	  DrawMesh(batch.mesh, cluster.material, MatrixIdentity());
+	  ++m_DrawCalls;
+	}
+  }
+}
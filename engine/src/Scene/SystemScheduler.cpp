@@ -0,0 +1,200 @@
+#include "repch.h"
+#include "Scene/SystemScheduler.h"
+#include "Scene/Scene.h"
+#include "Scene/CommandBuffer.h"
+#include "Core/ThreadPool.h"
+#include <chrono>
+
+namespace RE {
+
+  static bool Intersects(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b) {
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end()) {
+      if (*i == *j) return true;
+      if (*i < *j) ++i; else ++j;
+    }
+    return false;
+  }
+
+  namespace {
+    // One Run's queues, shared with pool helpers that may start (and find
+    // nothing left to do) after Run already returned.
+    struct RunState {
+      std::mutex mutex;
+      std::condition_variable progress;
+      std::vector<uint32_t> ready;      // any thread
+      std::vector<uint32_t> readyMain;  // calling thread only
+      uint32_t done = 0;
+      std::function<void(uint32_t)> execute;
+      std::function<size_t(uint32_t)> complete;
+    };
+
+    // drains the shared queue and exits once it is empty; touches nothing
+    // but `state` after a complete()
+    void Help(const std::shared_ptr<RunState>& state) {
+      for (;;) {
+	uint32_t node;
+	{
+	  std::lock_guard<std::mutex> lock(state->mutex);
+	  if (state->ready.empty()) return;
+	  node = state->ready.back();
+	  state->ready.pop_back();
+	}
+	state->execute(node);
+	for (size_t extra = state->complete(node); extra > 1; --extra)
+	  ThreadPool::Get().Submit([state]() { Help(state); });
+      }
+    }
+  }
+
+  bool SystemAccess::Conflicts(const SystemAccess& other) const {
+    if (m_Exclusive || other.m_Exclusive) return true;
+    return Intersects(m_Writes, other.m_Writes) || Intersects(m_Writes, other.m_Reads) ||
+	   Intersects(m_Reads, other.m_Writes);
+  }
+
+  SystemScheduler::SystemID SystemScheduler::Add(std::string_view name, const SystemAccess& access, SystemFn fn) {
+    System system;
+    system.id = m_NextID++;
+    system.name = StringInterner::Intern(name);
+    system.access = access;
+    system.fn = std::move(fn);
+    system.clock.Start(m_Time, 0.0, 0.0f);
+    m_Systems.push_back(std::move(system));
+    return m_Systems.back().id;
+  }
+
+  void SystemScheduler::Remove(SystemID id) {
+    m_Systems.erase(std::remove_if(m_Systems.begin(), m_Systems.end(),
+				   [id](const System& system) { return system.id == id; }),
+		    m_Systems.end());
+  }
+
+  void SystemScheduler::SetEnabled(SystemID id, bool enabled) {
+    if (System* system = Find(id))
+      system->enabled = enabled;
+    else
+      TraceLog(LOG_ERROR, "SetEnabled: unknown system %u", id);
+  }
+
+  void SystemScheduler::SetRate(SystemID id, float rateHz, float phase) {
+    System* system = Find(id);
+    if (!system) {
+      TraceLog(LOG_ERROR, "SetRate: unknown system %u", id);
+      return;
+    }
+    system->period = rateHz > 0.0f ? 1.0 / rateHz : 0.0;
+    if (phase < 0.0f) phase = TickClock::SpreadPhase(m_Spread++);
+    system->clock.Start(m_Time, system->period, std::min(phase, 1.0f));
+  }
+
+  SystemScheduler::System* SystemScheduler::Find(SystemID id) {
+    for (auto& system : m_Systems)
+      if (system.id == id) return &system;
+    return nullptr;
+  }
+
+  void SystemScheduler::Run(Scene& scene, entt::registry& registry, float dt) {
+    using Clock = std::chrono::steady_clock;
+    const auto frameStart = Clock::now();
+    m_Time += dt;
+
+    m_Frame.clear();
+    m_FrameDt.clear();
+    for (uint32_t i = 0; i < (uint32_t)m_Systems.size(); ++i) {
+      System& system = m_Systems[i];
+      if (!system.enabled || !system.clock.Due(m_Time)) continue;
+      m_Frame.push_back(i);
+      m_FrameDt.push_back(system.clock.Advance(m_Time, system.period));
+    }
+    const uint32_t count = (uint32_t)m_Frame.size();
+    m_Timings.assign(count, SystemTiming{});
+    m_FrameMs = 0.0f;
+    if (count == 0) return;
+
+    // DAG: each system waits for the earlier ones it conflicts with
+    m_Waits.assign(count, 0);
+    m_Successors.resize(count);
+    for (uint32_t j = 0; j < count; ++j) {
+      const System& system = m_Systems[m_Frame[j]];
+      m_Successors[j].clear();
+      m_Timings[j].name = system.name;
+      m_Timings[j].mainThread = system.access.m_MainThread;
+      for (auto assure : system.access.m_Pools)
+	assure(registry);
+      for (uint32_t i = 0; i < j; ++i)
+	if (m_Systems[m_Frame[i]].access.Conflicts(system.access)) {
+	  m_Successors[i].push_back(j);
+	  ++m_Waits[j];
+	}
+    }
+
+    auto state = std::make_shared<RunState>();
+    auto push = [this, &state](uint32_t node) {
+      (m_Systems[m_Frame[node]].access.m_MainThread ? state->readyMain : state->ready).push_back(node);
+    };
+    for (uint32_t node = 0; node < count; ++node)
+      if (m_Waits[node] == 0) push(node);
+
+    // Both are only called with a node taken from the queues, so before the
+    // last system is done and while Run, the scene and the scheduler are alive.
+    Scene* target = &scene;
+    state->execute = [this, target, frameStart](uint32_t node) {
+      const System& system = m_Systems[m_Frame[node]];
+      // ties with other systems resolve by system id, whatever thread ran it
+      CommandBuffer& commands = target->GetCommandBuffer();
+      commands.SetProducer(system.id);
+      const auto start = Clock::now();
+      system.fn(*target, m_FrameDt[node]);
+      const auto end = Clock::now();
+      commands.SetProducer(0);
+      m_Timings[node].startMs = std::chrono::duration<float, std::milli>(start - frameStart).count();
+      m_Timings[node].ms = std::chrono::duration<float, std::milli>(end - start).count();
+    };
+
+    // Marks `node` done and releases its successors. Returns how many became
+    // ready for any thread; the caller keeps one, helpers take the rest.
+    // Notifies under the lock: once the last system is done Run may return,
+    // and nothing but the shared state may be touched after the lock is released.
+    RunState* shared = state.get();
+    state->complete = [this, shared](uint32_t node) {
+      size_t released = 0;
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      ++shared->done;
+      for (uint32_t next : m_Successors[node])
+	if (--m_Waits[next] == 0) {
+	  const bool main = m_Systems[m_Frame[next]].access.m_MainThread;
+	  (main ? shared->readyMain : shared->ready).push_back(next);
+	  released += !main;
+	}
+      shared->progress.notify_all();
+      return released;
+    };
+
+    auto& pool = ThreadPool::Get();
+    for (size_t i = 0, n = std::min<size_t>(state->ready.size(), pool.GetWorkerCount()); i < n; ++i)
+      pool.Submit([state]() { Help(state); });
+
+    // the calling thread runs main-thread systems and helps with the rest
+    for (;;) {
+      uint32_t node;
+      {
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->progress.wait(lock, [&] {
+	  return state->done == count || !state->readyMain.empty() || !state->ready.empty();
+	});
+	if (state->done == count) break;
+	auto& queue = state->readyMain.empty() ? state->ready : state->readyMain;
+	node = queue.back();
+	queue.pop_back();
+      }
+      state->execute(node);
+      for (size_t extra = state->complete(node); extra > 1; --extra)
+	pool.Submit([state]() { Help(state); });
+    }
+    // helpers still queued only lock the state and find the queues empty
+
+    m_FrameMs = std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count();
+  }
+}
@@ -0,0 +1,170 @@
+#include "repch.h"
+#include "Scene/TransformPool.h"
+#include "Scene/Components.h"
+#include "Core/ThreadPool.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#define RE_TRANSFORM_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RE_TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace RE {
+
+  namespace {
+    // DrawModelEx turns every transform by one degree about its Rotation axis
+    const float HALF_SIN = std::sin(0.5f * DEG2RAD);
+    const float HALF_COS = std::cos(0.5f * DEG2RAD);
+
+    constexpr size_t MIN_BATCH = 4096; // per ThreadPool task
+    constexpr size_t CHUNK = 256;      // gathered then built while still in L1
+
+#if defined(RE_TRANSFORM_AVX2)
+    using Vec = __m256;
+    constexpr size_t WIDTH = 8;
+    inline Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    inline Vec Set(float f) { return _mm256_set1_ps(f); }
+    inline Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    inline Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    inline Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    // 1/sqrt(v), 0 where v is 0
+    inline Vec InvLength(Vec v) {
+      const Vec inv = _mm256_div_ps(Set(1.0f), _mm256_sqrt_ps(v));
+      return _mm256_and_ps(inv, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+#elif defined(RE_TRANSFORM_SSE)
+    using Vec = __m128;
+    constexpr size_t WIDTH = 4;
+    inline Vec Load(const float* p) { return _mm_loadu_ps(p); }
+    inline void Store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+    inline Vec Set(float f) { return _mm_set1_ps(f); }
+    inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    inline Vec InvLength(Vec v) {
+      const Vec inv = _mm_div_ps(Set(1.0f), _mm_sqrt_ps(v));
+      return _mm_and_ps(inv, _mm_cmpgt_ps(v, _mm_setzero_ps()));
+    }
+#endif
+
+#if defined(RE_TRANSFORM_AVX2) || defined(RE_TRANSFORM_SSE)
+    // Four matrices from element registers in Matrix field order; each group
+    // of four fields is transposed so an entity's floats are stored together.
+    inline void StoreFour(const __m128 (&e)[16], Matrix* out) {
+      for (int g = 0; g < 4; ++g) {
+	__m128 r0 = e[4 * g], r1 = e[4 * g + 1], r2 = e[4 * g + 2], r3 = e[4 * g + 3];
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(reinterpret_cast<float*>(out + 0) + 4 * g, r0);
+	_mm_storeu_ps(reinterpret_cast<float*>(out + 1) + 4 * g, r1);
+	_mm_storeu_ps(reinterpret_cast<float*>(out + 2) + 4 * g, r2);
+	_mm_storeu_ps(reinterpret_cast<float*>(out + 3) + 4 * g, r3);
+      }
+    }
+#endif
+  }
+
+  static void BuildOne(TransformPool::Lanes& l, size_t i, Matrix& m) {
+    const float lengthSq = l.qx[i] * l.qx[i] + l.qy[i] * l.qy[i] + l.qz[i] * l.qz[i];
+    const float scale = lengthSq > 0.0f ? HALF_SIN / std::sqrt(lengthSq) : 0.0f;
+    const float x = l.qx[i] *= scale, y = l.qy[i] *= scale, z = l.qz[i] *= scale;
+    const float w = l.qw[i] = HALF_COS;
+
+    m.m0 = (1.0f - 2.0f * (y * y + z * z)) * l.sx[i];
+    m.m1 = 2.0f * (x * y + z * w) * l.sx[i];
+    m.m2 = 2.0f * (x * z - y * w) * l.sx[i];
+    m.m3 = 0.0f;
+    m.m4 = 2.0f * (x * y - z * w) * l.sy[i];
+    m.m5 = (1.0f - 2.0f * (x * x + z * z)) * l.sy[i];
+    m.m6 = 2.0f * (y * z + x * w) * l.sy[i];
+    m.m7 = 0.0f;
+    m.m8 = 2.0f * (x * z + y * w) * l.sz[i];
+    m.m9 = 2.0f * (y * z - x * w) * l.sz[i];
+    m.m10 = (1.0f - 2.0f * (x * x + y * y)) * l.sz[i];
+    m.m11 = 0.0f;
+    m.m12 = l.x[i];
+    m.m13 = l.y[i];
+    m.m14 = l.z[i];
+    m.m15 = 1.0f;
+  }
+
+  void TransformPool::BuildMatrices(Lanes& l, size_t begin, size_t end, Matrix* out) {
+    size_t i = begin;
+#if defined(RE_TRANSFORM_AVX2) || defined(RE_TRANSFORM_SSE)
+    const Vec one = Set(1.0f), two = Set(2.0f), zero = Set(0.0f);
+    const Vec halfSin = Set(HALF_SIN), halfCos = Set(HALF_COS);
+    for (; i + WIDTH <= end; i += WIDTH) {
+      // axis -> unit quaternion, written back to the lanes
+      Vec x = Load(&l.qx[i]), y = Load(&l.qy[i]), z = Load(&l.qz[i]);
+      const Vec scale = Mul(InvLength(Add(Add(Mul(x, x), Mul(y, y)), Mul(z, z))), halfSin);
+      x = Mul(x, scale); y = Mul(y, scale); z = Mul(z, scale);
+      const Vec w = halfCos;
+      Store(&l.qx[i], x); Store(&l.qy[i], y); Store(&l.qz[i], z); Store(&l.qw[i], w);
+
+      const Vec sx = Load(&l.sx[i]), sy = Load(&l.sy[i]), sz = Load(&l.sz[i]);
+      const Vec xx = Mul(x, x), yy = Mul(y, y), zz = Mul(z, z);
+      const Vec xy = Mul(x, y), xz = Mul(x, z), yz = Mul(y, z);
+      const Vec xw = Mul(x, w), yw = Mul(y, w), zw = Mul(z, w);
+
+      // Matrix field order: m0 m4 m8 m12 / m1 m5 m9 m13 / m2 m6 m10 m14 / m3 m7 m11 m15
+      const Vec e[16] = {
+	Mul(Sub(one, Mul(two, Add(yy, zz))), sx), Mul(Mul(two, Sub(xy, zw)), sy), Mul(Mul(two, Add(xz, yw)), sz), Load(&l.x[i]),
+	Mul(Mul(two, Add(xy, zw)), sx), Mul(Sub(one, Mul(two, Add(xx, zz))), sy), Mul(Mul(two, Sub(yz, xw)), sz), Load(&l.y[i]),
+	Mul(Mul(two, Sub(xz, yw)), sx), Mul(Mul(two, Add(yz, xw)), sy), Mul(Sub(one, Mul(two, Add(xx, yy))), sz), Load(&l.z[i]),
+	zero, zero, zero, one,
+      };
+
+#if defined(RE_TRANSFORM_AVX2)
+      __m128 lo[16], hi[16];
+      for (int k = 0; k < 16; ++k) {
+	lo[k] = _mm256_castps256_ps128(e[k]);
+	hi[k] = _mm256_extractf128_ps(e[k], 1);
+      }
+      StoreFour(lo, out + (i - begin));
+      StoreFour(hi, out + (i - begin) + 4);
+#else
+      StoreFour(e, out + (i - begin));
+#endif
+    }
+#endif
+    for (; i < end; ++i)
+      BuildOne(l, i, out[i - begin]);
+  }
+
+  void TransformPool::Update(const entt::registry& registry) {
+    const auto* storage = registry.storage<TransformComponent>();
+    const size_t count = storage ? storage->size() : 0;
+    m_Entities.resize(count);
+    m_World.resize(count);
+    for (auto* lane : { &m_Lanes.x, &m_Lanes.y, &m_Lanes.z, &m_Lanes.qx, &m_Lanes.qy, &m_Lanes.qz,
+			&m_Lanes.qw, &m_Lanes.sx, &m_Lanes.sy, &m_Lanes.sz })
+      lane->resize(count);
+    if (count == 0) return;
+
+    // every entity index is below the entity pool's size
+    const auto* entities = registry.storage<entt::entity>();
+    if (m_IndexOf.size() < entities->size()) m_IndexOf.resize(entities->size());
+
+    // gather (AoS -> SoA) and build per batch, while the batch is in cache
+    constexpr size_t PAGE = entt::component_traits<TransformComponent>::page_size;
+    const entt::entity* packed = storage->data();
+    const auto* pages = storage->raw();
+    ThreadPool::Get().ParallelFor(count, MIN_BATCH, [&](size_t begin, size_t end) {
+      for (size_t first = begin; first < end; first += CHUNK) {
+	const size_t last = std::min(first + CHUNK, end);
+	for (size_t i = first; i < last; ++i) {
+	  const TransformComponent& t = pages[i / PAGE][i % PAGE];
+	  m_Entities[i] = packed[i];
+	  m_IndexOf[entt::to_entity(packed[i])] = (uint32_t)i;
+	  m_Lanes.x[i] = t.Translation.x; m_Lanes.y[i] = t.Translation.y; m_Lanes.z[i] = t.Translation.z;
+	  m_Lanes.qx[i] = t.Rotation.x; m_Lanes.qy[i] = t.Rotation.y; m_Lanes.qz[i] = t.Rotation.z;
+	  m_Lanes.sx[i] = t.Scale.x; m_Lanes.sy[i] = t.Scale.y; m_Lanes.sz[i] = t.Scale.z;
+	}
+	BuildMatrices(m_Lanes, first, last, m_World.data() + first);
+      }
+    });
+  }
+}
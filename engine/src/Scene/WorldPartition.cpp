@@ -0,0 +1,338 @@
+#include "repch.h"
+#include "Scene/WorldPartition.h"
+#include "Scene/SceneSerializer.h"
+#include "Scene/Scene.h"
+#include "Scene/Components.h"
+#include "Core/ThreadPool.h"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace RE {
+
+  namespace {
+    constexpr uint32_t PARTITION_MAGIC = 0x49505752; // "RWPI"
+    constexpr uint32_t PARTITION_VERSION = 1;
+    constexpr const char* PARTITION_INDEX = "partition.idx";
+
+    struct IndexHeader {
+      uint32_t magic;
+      uint32_t version;
+      float cellSize;
+      uint32_t cellCount;
+    };
+
+    struct IndexCell {
+      int32_t x;
+      int32_t z;
+    };
+  }
+
+  WorldPartition::WorldPartition(Scene* scene, AssetRegistry* assets)
+    : m_Scene(scene), m_Assets(assets) {}
+
+  // streamed entities belong to the scene and stay; Close() removes them
+  WorldPartition::~WorldPartition() = default;
+
+  std::string WorldPartition::CellPath(int x, int z) const {
+    return (std::filesystem::path(m_Directory) / ("cell_" + std::to_string(x) + "_" + std::to_string(z) + ".rscn")).string();
+  }
+
+  // --- Baking ----------------------------------------------------------------------
+  bool WorldPartition::Bake(Scene& scene, const std::string& directory, float cellSize) {
+    if (cellSize <= 0.0f) {
+      TraceLog(LOG_ERROR, "World partition cell size must be positive");
+      return false;
+    }
+
+    auto& registry = scene.m_Registry;
+    std::unordered_map<uint64_t, std::vector<entt::entity>> cells;
+    for (auto [entity, id, transform] : registry.view<IDComponent, TransformComponent>().each()) {
+      if (registry.any_of<Camera3DComponent, SkyboxComponent, TerrainComponent>(entity)) continue;
+      const int x = (int)std::floor(transform.Translation.x / cellSize);
+      const int z = (int)std::floor(transform.Translation.z / cellSize);
+      cells[CellKey(x, z)].push_back(entity);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    WorldPartition writer(&scene);
+    writer.m_Directory = directory;
+    SceneSerializer serializer(&scene);
+    std::vector<IndexCell> index;
+    index.reserve(cells.size());
+    for (auto& [key, entities] : cells) {
+      const IndexCell cell{ (int32_t)(key >> 32), (int32_t)(uint32_t)key };
+      if (!serializer.SerializeBinary(writer.CellPath(cell.x, cell.z), entities))
+	return false;
+      index.push_back(cell);
+    }
+
+    const IndexHeader header{ PARTITION_MAGIC, PARTITION_VERSION, cellSize, (uint32_t)index.size() };
+    std::ofstream file(std::filesystem::path(directory) / PARTITION_INDEX, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)index.data(), (std::streamsize)(index.size() * sizeof(IndexCell)));
+    if (!file) {
+      TraceLog(LOG_ERROR, "Cannot write world partition index in %s", directory.c_str());
+      return false;
+    }
+    TraceLog(LOG_INFO, "Baked %zu world cells into %s", index.size(), directory.c_str());
+    return true;
+  }
+
+  // --- Streaming -------------------------------------------------------------------
+  bool WorldPartition::Open(const std::string& directory, const WorldPartitionSettings& settings) {
+    Close();
+
+    std::ifstream file(std::filesystem::path(directory) / PARTITION_INDEX, std::ios::binary);
+    IndexHeader header{};
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != PARTITION_MAGIC ||
+	header.version != PARTITION_VERSION || header.cellSize <= 0.0f) {
+      TraceLog(LOG_ERROR, "No world partition index in %s", directory.c_str());
+      return false;
+    }
+    std::vector<IndexCell> index(header.cellCount);
+    if (!file.read((char*)index.data(), (std::streamsize)(index.size() * sizeof(IndexCell)))) {
+      TraceLog(LOG_ERROR, "World partition index in %s is truncated", directory.c_str());
+      return false;
+    }
+
+    m_Directory = directory;
+    m_CellSize = header.cellSize;
+    m_Settings = settings;
+    m_Settings.unloadRadius = std::max(m_Settings.unloadRadius, m_Settings.loadRadius);
+    m_Cells.reserve(index.size());
+    for (const auto& entry : index) {
+      Cell cell;
+      cell.x = entry.x;
+      cell.z = entry.z;
+      m_Cells.emplace(CellKey(entry.x, entry.z), std::move(cell));
+    }
+    m_Stats = {};
+    m_Stats.cells = (int)m_Cells.size();
+    return true;
+  }
+
+  Ref<WorldPartition> WorldPartition::Clone(Scene* scene) const {
+    auto clone = CreateRef<WorldPartition>(scene, m_Assets);
+    clone->m_Directory = m_Directory;
+    clone->m_CellSize = m_CellSize;
+    clone->m_Settings = m_Settings;
+    clone->m_Cells = m_Cells;
+    clone->m_DestroyQueue = m_DestroyQueue;
+    // the runtime scene's OnRuntimeStart gives every resident rigidbody its body
+    for (auto key : m_Resident) {
+      Cell& cell = clone->m_Cells[key];
+      // loaders belong to this partition; their progress is not shared
+      cell.load.reset();
+      if (cell.state == CellState::Loaded) {
+	clone->m_Resident.push_back(key);
+	continue;
+      }
+      clone->m_DestroyQueue.insert(clone->m_DestroyQueue.end(), cell.entities.begin(), cell.entities.end());
+      cell.entities.clear();
+      cell.state = CellState::Unloaded;
+    }
+    clone->m_Stats = m_Stats;
+    return clone;
+  }
+
+  void WorldPartition::Close() {
+    for (auto key : m_Resident)
+      Unload(m_Cells[key]);
+    m_Resident.clear();
+
+    // everything at once; no budget when shutting the world down
+    const int budget = m_Settings.entityBudget;
+    m_Settings.entityBudget = std::numeric_limits<int>::max();
+    FlushDestroys();
+    m_Settings.entityBudget = budget;
+
+    m_BodyQueue.clear();
+    m_Cells.clear();
+    // reads still running keep counting against the next Open
+    m_LoadsInFlight = (int)m_AbandonedLoads.size();
+    m_Stats = {};
+  }
+
+  float WorldPartition::CellDistance(const Cell& cell, const Vector3& focus) const {
+    // distance from the focus to the cell's XZ rectangle
+    const float minX = cell.x * m_CellSize, minZ = cell.z * m_CellSize;
+    const float dx = std::max({ minX - focus.x, 0.0f, focus.x - (minX + m_CellSize) });
+    const float dz = std::max({ minZ - focus.z, 0.0f, focus.z - (minZ + m_CellSize) });
+    return std::sqrt(dx * dx + dz * dz);
+  }
+
+  void WorldPartition::Update(const Vector3& focus) {
+    if (m_Cells.empty()) return;
+
+    UnloadFar(focus);
+    StartLoads(focus);
+    Integrate(focus);
+    FlushDestroys();
+    FlushBodies();
+
+    m_Stats.loading = m_Stats.integrating = m_Stats.loaded = 0;
+    m_Stats.residentEntities = 0;
+    for (auto key : m_Resident) {
+      const Cell& cell = m_Cells[key];
+      m_Stats.loading += cell.state == CellState::Loading;
+      m_Stats.integrating += cell.state == CellState::Integrating;
+      m_Stats.loaded += cell.state == CellState::Loaded;
+      m_Stats.residentEntities += cell.entities.size();
+    }
+    m_Stats.pendingDestroys = m_DestroyQueue.size();
+    m_Stats.pendingBodies = m_BodyQueue.size();
+  }
+
+  void WorldPartition::UnloadFar(const Vector3& focus) {
+    // hysteresis: cells load inside loadRadius but only leave beyond unloadRadius
+    for (size_t i = 0; i < m_Resident.size();) {
+      Cell& cell = m_Cells[m_Resident[i]];
+      if (CellDistance(cell, focus) > m_Settings.unloadRadius) {
+	Unload(cell);
+	m_Resident[i] = m_Resident.back();
+	m_Resident.pop_back();
+      } else {
+	++i;
+      }
+    }
+  }
+
+  void WorldPartition::Unload(Cell& cell) {
+    // the worker keeps reading; it counts as in flight until it finishes
+    if (cell.state == CellState::Loading)
+      m_AbandonedLoads.push_back(std::move(cell.load));
+    cell.load.reset();
+    m_DestroyQueue.insert(m_DestroyQueue.end(), cell.entities.begin(), cell.entities.end());
+    cell.entities.clear();
+    cell.entities.shrink_to_fit();
+    cell.state = CellState::Unloaded;
+  }
+
+  void WorldPartition::StartLoads(const Vector3& focus) {
+    // reads of cells unloaded mid-load are dropped once they finish
+    for (size_t i = 0; i < m_AbandonedLoads.size();) {
+      if (m_AbandonedLoads[i]->ready.load(std::memory_order_acquire)) {
+	--m_LoadsInFlight;
+	m_AbandonedLoads[i] = std::move(m_AbandonedLoads.back());
+	m_AbandonedLoads.pop_back();
+      } else {
+	++i;
+      }
+    }
+    if (m_LoadsInFlight >= m_Settings.maxLoadsInFlight) return;
+
+    // only the cells around the focus are looked at, not the whole world
+    const float radius = m_Settings.loadRadius;
+    const int x0 = (int)std::floor((focus.x - radius) / m_CellSize);
+    const int x1 = (int)std::floor((focus.x + radius) / m_CellSize);
+    const int z0 = (int)std::floor((focus.z - radius) / m_CellSize);
+    const int z1 = (int)std::floor((focus.z + radius) / m_CellSize);
+
+    std::vector<std::pair<float, uint64_t>> candidates;
+    for (int z = z0; z <= z1; ++z)
+      for (int x = x0; x <= x1; ++x) {
+	auto it = m_Cells.find(CellKey(x, z));
+	if (it == m_Cells.end() || it->second.state != CellState::Unloaded) continue;
+	const float distance = CellDistance(it->second, focus);
+	if (distance <= radius)
+	  candidates.emplace_back(distance, it->first);
+      }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto& [distance, key] : candidates) {
+      if (m_LoadsInFlight >= m_Settings.maxLoadsInFlight) break;
+      Cell& cell = m_Cells[key];
+      auto load = CreateRef<PendingLoad>();
+      load->loader = CreateScope<SceneLoader>();
+      cell.load = load;
+      cell.state = CellState::Loading;
+      m_Resident.push_back(key);
+      ++m_LoadsInFlight;
+
+      ThreadPool::Get().Submit([load, path = CellPath(cell.x, cell.z)] {
+	load->ok = load->loader->Open(path);
+	load->ready.store(true, std::memory_order_release);
+      });
+    }
+  }
+
+  void WorldPartition::Integrate(const Vector3& focus) {
+    // finished reads move on to integration
+    std::vector<std::pair<float, uint64_t>> integrating;
+    for (auto key : m_Resident) {
+      Cell& cell = m_Cells[key];
+      if (cell.state == CellState::Loading && cell.load->ready.load(std::memory_order_acquire)) {
+	--m_LoadsInFlight;
+	if (!cell.load->ok) {
+	  // keep it resident and empty so a broken file is not re-read every frame
+	  cell.load.reset();
+	  cell.state = CellState::Loaded;
+	  continue;
+	}
+	cell.state = CellState::Integrating;
+      }
+      if (cell.state == CellState::Integrating)
+	integrating.emplace_back(CellDistance(cell, focus), key);
+    }
+    std::sort(integrating.begin(), integrating.end());
+
+    // nearest cells first, one shared entity budget per frame
+    size_t budget = (size_t)std::max(m_Settings.entityBudget, 0);
+    const bool playing = m_Scene->IsRunning();
+    for (const auto& [distance, key] : integrating) {
+      if (budget == 0) break;
+      Cell& cell = m_Cells[key];
+      const size_t first = cell.entities.size();
+      budget -= cell.load->loader->Integrate(*m_Scene, m_Assets, budget, &cell.entities);
+
+      // bodies for new rigidbodies follow under their own budget
+      if (playing)
+	for (size_t i = first; i < cell.entities.size(); ++i)
+	  if (m_Scene->m_Registry.all_of<RigidbodyComponent>(cell.entities[i]))
+	    m_BodyQueue.push_back(cell.entities[i]);
+
+      if (cell.load->loader->Done()) {
+	cell.load.reset();
+	cell.state = CellState::Loaded;
+      }
+    }
+  }
+
+  void WorldPartition::FlushDestroys() {
+    if (m_DestroyQueue.empty()) return;
+    auto& registry = m_Scene->m_Registry;
+
+    const size_t count = std::min(m_DestroyQueue.size(), (size_t)std::max(m_Settings.entityBudget, 0));
+    const auto first = m_DestroyQueue.end() - (std::ptrdiff_t)count;
+    // the scene's destroy hooks queue bodies; they leave the world in one pass
+    const auto last = std::remove_if(first, m_DestroyQueue.end(),
+				     [&registry](entt::entity e) { return !registry.valid(e); });
+    registry.destroy(first, last);
+    m_DestroyQueue.erase(first, m_DestroyQueue.end());
+    m_Scene->FlushReleases();
+  }
+
+  void WorldPartition::FlushBodies() {
+    if (m_BodyQueue.empty()) return;
+    auto& registry = m_Scene->m_Registry;
+
+    // edit mode: OnRuntimeStart creates bodies for everything that is resident
+    if (!m_Scene->IsRunning()) {
+      m_BodyQueue.clear();
+      return;
+    }
+
+    const size_t count = std::min(m_BodyQueue.size(), (size_t)std::max(m_Settings.bodyBudget, 0));
+    for (size_t i = 0; i < count; ++i) {
+      const entt::entity entity = m_BodyQueue[i];
+      if (!registry.valid(entity)) continue;
+      auto [rigidbody, transform] = registry.get<RigidbodyComponent, TransformComponent>(entity);
+      if (!rigidbody.body)
+	m_Scene->CreateRigidBody(entity, rigidbody, transform);
+    }
+    m_BodyQueue.erase(m_BodyQueue.begin(), m_BodyQueue.begin() + (std::ptrdiff_t)count);
+  }
+}